@@ -32,6 +32,7 @@
 #include <deal.II/grid/tria_boundary_lib.h>
 #include <deal.II/grid/grid_tools.h>
 #include <deal.II/grid/grid_in.h>
+#include <deal.II/grid/grid_tools_cache.h>
 
 #include <deal.II/dofs/dof_handler.h>
 #include <deal.II/dofs/dof_renumbering.h>
@@ -51,17 +52,31 @@
 #include <deal.II/numerics/data_out.h>
 #include <deal.II/numerics/solution_transfer.h>
 
-#include <deal.II/lac/generic_linear_algebra.h>
-namespace LA
-{
-  using namespace dealii::LinearAlgebraTrilinos;
-}
 #include <deal.II/distributed/tria.h>
 #include <deal.II/distributed/grid_refinement.h>
 #include <deal.II/distributed/solution_transfer.h>
 
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/text_oarchive.hpp>
+#include <boost/serialization/map.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
 #include <fstream>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <set>
 #include <sstream>
+#include <tuple>
+
+#include "cracks.h"
 
 using namespace dealii;
 
@@ -362,16 +377,11 @@ public:
     : exact(eps)
   {}
 
-  void compute_derived_quantities_vector (const std::vector<Vector<double> >              &uh,
-                                          const std::vector<std::vector<Tensor<1,dim> > > &duh,
-                                          const std::vector<std::vector<Tensor<2,dim> > > &dduh,
-                                          const std::vector<Point<dim> >                  &normals,
-                                          const std::vector<Point<dim> >                   &evaluation_points,
-                                          std::vector<Vector<double> >                    &computed_quantities) const
-
+  virtual void evaluate_vector_field (const DataPostprocessorInputs::Vector<dim> &input_data,
+                                      std::vector<Vector<double> > &computed_quantities) const
   {
     for (unsigned int i=0; i<computed_quantities.size(); ++i)
-      computed_quantities[i][0] = exact.value(evaluation_points[i]);
+      computed_quantities[i][0] = exact.value(input_data.evaluation_points[i]);
   }
 
   virtual std::vector<std::string> get_names () const
@@ -398,6 +408,177 @@ private:
 };
 
 
+// The phase field alone, for output without the displacements
+template <int dim>
+class PhaseFieldPostProc : public DataPostprocessor<dim>
+{
+public:
+  virtual void evaluate_vector_field (const DataPostprocessorInputs::Vector<dim> &input_data,
+                                      std::vector<Vector<double> > &computed_quantities) const
+  {
+    for (unsigned int i=0; i<computed_quantities.size(); ++i)
+      computed_quantities[i][0] = input_data.solution_values[i](dim);
+  }
+
+  virtual std::vector<std::string> get_names () const
+  {
+    std::vector<std::string> r;
+    r.push_back("phi");
+    return r;
+  }
+
+  virtual
+  std::vector<DataComponentInterpretation::DataComponentInterpretation>
+  get_data_component_interpretation () const
+  {
+    std::vector<DataComponentInterpretation::DataComponentInterpretation> r;
+    r.push_back(DataComponentInterpretation::component_is_scalar);
+    return r;
+  }
+  virtual UpdateFlags get_needed_update_flags () const
+  {
+    return  update_values;
+  }
+};
+
+
+// Copy of the patches of a DataOut object. It does not refer to the
+// mesh or the solution vectors any more and can be written while
+// these change, e.g., on a background thread.
+template <int dim>
+class OutputBuffer : public DataOutInterface<dim>
+{
+public:
+  std::vector<DataOutBase::Patch<dim> > patches;
+  std::vector<std::string> dataset_names;
+  std::vector<std::tuple<unsigned int, unsigned int, std::string,
+      DataComponentInterpretation::DataComponentInterpretation> > nonscalar_data_ranges;
+
+protected:
+  virtual const std::vector<DataOutBase::Patch<dim> > &get_patches () const
+  {
+    return patches;
+  }
+
+  virtual std::vector<std::string> get_dataset_names () const
+  {
+    return dataset_names;
+  }
+
+  virtual
+  std::vector<std::tuple<unsigned int, unsigned int, std::string,
+      DataComponentInterpretation::DataComponentInterpretation> >
+      get_nonscalar_data_ranges () const
+  {
+    return nonscalar_data_ranges;
+  }
+};
+
+
+// DataOut that can hand its patches over to an OutputBuffer
+template <int dim>
+class BufferedDataOut : public DataOut<dim>
+{
+public:
+  void copy_patches (OutputBuffer<dim> &buffer) const
+  {
+    buffer.patches = this->get_patches();
+    buffer.dataset_names = this->get_dataset_names();
+    buffer.nonscalar_data_ranges = this->get_nonscalar_data_ranges();
+  }
+};
+
+
+// DataOut that only writes the active cells marked in the given
+// vector (indexed by the active cell index)
+template <int dim>
+class SelectedCellsDataOut : public BufferedDataOut<dim>
+{
+public:
+  SelectedCellsDataOut (const std::vector<bool> &selected)
+    : selected(selected)
+  {}
+
+  virtual typename DataOut<dim>::cell_iterator first_cell ()
+  {
+    return next_selected(this->triangulation->begin_active());
+  }
+
+  virtual typename DataOut<dim>::cell_iterator next_cell (
+    const typename DataOut<dim>::cell_iterator &cell)
+  {
+    typename Triangulation<dim>::active_cell_iterator active_cell = cell;
+    ++active_cell;
+    return next_selected(active_cell);
+  }
+
+private:
+  typename DataOut<dim>::cell_iterator next_selected (
+    typename Triangulation<dim>::active_cell_iterator cell) const
+  {
+    while (cell != this->triangulation->end()
+           && !selected[cell->active_cell_index()])
+      ++cell;
+    return cell;
+  }
+
+  const std::vector<bool> &selected;
+};
+
+
+// Write the .vtu file of this processor and, on the first processor,
+// the .pvtu and .visit records of one output step into the given
+// directory. Returns the size of the .vtu file in MB and the time taken
+// to write it in seconds.
+template <int dim>
+std::pair<double, double>
+write_output_files (const DataOutInterface<dim> &data_out,
+                    const std::string &directory,
+                    const std::string &filename_basis,
+                    const unsigned int refinement_cycle,
+                    const unsigned int my_rank,
+                    const unsigned int n_ranks)
+{
+  std::ostringstream filename;
+  filename << directory << "/"
+           << filename_basis
+           << Utilities::int_to_string(refinement_cycle, 5)
+           << "."
+           << Utilities::int_to_string(my_rank, 4)
+           << ".vtu";
+
+  const std::chrono::steady_clock::time_point start
+    = std::chrono::steady_clock::now();
+  std::ofstream output(filename.str().c_str());
+  data_out.write_vtu(output);
+  const double megabytes = static_cast<double>(output.tellp()) / 1.0e6;
+  output.close();
+  const double seconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start).count();
+
+  if (my_rank == 0)
+    {
+      std::vector<std::string> filenames;
+      for (unsigned int i = 0; i < n_ranks; ++i)
+        filenames.push_back(
+          filename_basis + Utilities::int_to_string(refinement_cycle, 5)
+          + "." + Utilities::int_to_string(i, 4) + ".vtu");
+
+      std::ofstream master_output(
+        (directory + "/" + filename_basis + Utilities::int_to_string(refinement_cycle, 5)
+         + ".pvtu").c_str());
+      data_out.write_pvtu_record(master_output, filenames);
+
+      std::string visit_master_filename = (directory + "/" + filename_basis
+                                           + Utilities::int_to_string(refinement_cycle, 5) + ".visit");
+      std::ofstream visit_master(visit_master_filename.c_str());
+      data_out.write_visit_record(visit_master, filenames);
+    }
+
+  return std::make_pair(megabytes, seconds);
+}
+
+
 
 // Class for initial values multiple fractures in a homogeneous material
 template <int dim>
@@ -738,233 +919,196 @@ BoundaryParabelShear<dim>::vector_value (const Point<dim> &p,
 
 
 
-
-// Main program
+// The constructor of this class is comparable
+// to other tutorials steps, e.g., step-22, and step-31.
 template <int dim>
-class FracturePhaseFieldProblem
-{
-public:
+FracturePhaseFieldProblem<dim>::FracturePhaseFieldProblem (
+  const unsigned int degree, ParameterHandler &param,
+  const MPI_Comm &comm, std::ostream &out)
+  :
+  mpi_com(comm),
+  degree(degree),
+  prm(param),
+  triangulation(mpi_com),
+  grid_cache(triangulation),
 
-  FracturePhaseFieldProblem (
-    const unsigned int degree, ParameterHandler &);
-  void
-  run ();
-  static void
-  declare_parameters (ParameterHandler &prm);
+  fe(FE_Q<dim>(degree), dim, FE_Q<dim>(degree), 1),
+  dof_handler(triangulation),
 
-private:
+  pcout(out, (Utilities::MPI::this_mpi_process(mpi_com) == 0)),
+  timer(mpi_com, pcout, TimerOutput::every_call_and_summary,
+        TimerOutput::cpu_and_wall_times),
+  func_emodulus(0),
+  output_group_com(MPI_COMM_NULL),
+  initialized(false)
+{
+}
 
-  void
-  set_runtime_parameters ();
-  void
-  determine_mesh_dependent_parameters();
-  void
-  setup_system ();
-  void
-  assemble_system (bool residual_only=false);
-  void
-  assemble_nl_residual ();
 
-  void assemble_diag_mass_matrix();
 
-  void
-  set_initial_bc (
-    const double time);
-  void
-  set_newton_bc ();
+template <int dim>
+FracturePhaseFieldProblem<dim>::~FracturePhaseFieldProblem ()
+{
+  // Pending output refers to this object
+  flush_output();
+  if (output_group_com != MPI_COMM_NULL)
+    MPI_Comm_free(&output_group_com);
+  delete func_emodulus;
+}
 
-  unsigned int
-  solve ();
 
-  double newton_active_set();
 
-  double
-  newton_iteration (
-    const double time);
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::declare_parameters (ParameterHandler &prm)
+{
+  prm.enter_subsection("Global parameters");
+  {
+    prm.declare_entry("Global pre-refinement steps", "1",
+                      Patterns::Integer(0));
 
-  double
-  compute_point_value (
-    const DoFHandler<dim> &dofh, const LA::MPI::BlockVector &vector,
-    const Point<dim> &p, const unsigned int component) const;
+    prm.declare_entry("Local pre-refinement steps", "0",
+                      Patterns::Integer(0));
 
-  void
-  output_results () const;
+    prm.declare_entry("Adaptive refinement cycles", "0",
+                      Patterns::Integer(0));
 
-  void
-  compute_functional_values ();
+    prm.declare_entry("Max No of timesteps", "1", Patterns::Integer(0));
 
-  void
-  compute_load();
+    prm.declare_entry("Timestep size", "1.0", Patterns::Double(0));
 
-  void compute_cod_array ();
+    prm.declare_entry("Timestep size to switch to", "1.0", Patterns::Double(0));
 
-  double
-  compute_cod (
-    const double eval_line);
+    prm.declare_entry("Switch timestep after steps", "0", Patterns::Integer(0));
 
-  double compute_energy();
+    prm.declare_entry("Timestep control", "fixed",
+                      Patterns::Selection("fixed|adaptive"));
 
-  bool
-  refine_mesh ();
-  void
-  project_back_phase_field ();
+    prm.declare_entry("Minimal timestep size", "1.0e-10", Patterns::Double(0));
 
-  MPI_Comm mpi_com;
+    prm.declare_entry("Maximal timestep size", "1.0", Patterns::Double(0));
 
-  const unsigned int degree;
-  ParameterHandler &prm;
+    prm.declare_entry("Timestep growth limit", "2.0", Patterns::Double(1));
 
-  parallel::distributed::Triangulation<dim> triangulation;
+    prm.declare_entry("Target Newton iterations", "6", Patterns::Integer(1));
 
-  FESystem<dim> fe;
-  DoFHandler<dim> dof_handler;
-  ConstraintMatrix constraints_update;
-  ConstraintMatrix constraints_hanging_nodes;
+    prm.declare_entry("Target phase-field change", "0.2", Patterns::Double(0));
 
-  LA::MPI::BlockSparseMatrix system_pde_matrix;
-  LA::MPI::BlockVector solution, newton_update,
-  old_solution, old_old_solution, system_pde_residual;
-  LA::MPI::BlockVector system_total_residual;
+    prm.declare_entry("outer solver", "active set",
+                      Patterns::Selection("active set|simple monolithic"));
 
-  LA::MPI::BlockVector diag_mass, diag_mass_relevant;
+    prm.declare_entry("test case", "sneddon 2d", Patterns::Selection("sneddon 2d|miehe tension|miehe shear|multiple homo|multiple het"));
 
-  ConditionalOStream pcout;
-  TimerOutput timer;
+    prm.declare_entry("E modulus bitmap", "test.pgm",
+                      Patterns::Anything());
 
-  IndexSet active_set;
+    prm.declare_entry("ref strategy", "phase field",
+                      Patterns::Selection("phase field|fixed preref sneddon|fixed preref miehe tension|fixed preref miehe shear|fixed preref multiple homo|fixed preref multiple het|global|mix"));
 
-  Function<dim> *func_emodulus;
+    prm.declare_entry("value phase field for refinement", "0.0", Patterns::Double(0));
 
-  std::vector<IndexSet> partition;
-  std::vector<IndexSet> partition_relevant;
+    prm.declare_entry("Refine to target level", "false", Patterns::Bool());
 
-  std::vector<std::vector<bool> > constant_modes;
+    prm.declare_entry("Predictive refinement", "none",
+                      Patterns::Selection("none|driving force|phase field rate"));
 
-  LA::MPI::PreconditionAMG preconditioner_solid;
-  LA::MPI::PreconditionAMG preconditioner_phase_field;
+    prm.declare_entry("Predictive refinement band width", "0.0", Patterns::Double(0));
 
-  // Global variables for timestepping scheme
-  unsigned int timestep_number;
-  unsigned int max_no_timesteps;
-  double timestep, timestep_size_2, time;
-  unsigned int switch_timestep;
-  struct OuterSolverType
-  {
-    enum Enum {active_set, simple_monolithic};
-  };
-  typename OuterSolverType::Enum outer_solver;
+    prm.declare_entry("Coarsening", "false", Patterns::Bool());
 
-  struct TestCase
-  {
-    enum Enum {sneddon_2d, miehe_tension, miehe_shear, multiple_homo, multiple_het};
-  };
-  typename TestCase::Enum test_case;
+    prm.declare_entry("Coarsening distance", "0.0", Patterns::Double(0));
 
-  struct RefinementStrategy
-  {
-    enum Enum {phase_field_ref, fixed_preref_sneddon, fixed_preref_miehe_tension,
-               fixed_preref_miehe_shear, fixed_preref_multiple_homo, fixed_preref_multiple_het,
-               global, mix
-              };
-  };
-  typename RefinementStrategy::Enum refinement_strategy;
+    prm.declare_entry("value phase field for coarsening", "0.95", Patterns::Double(0));
 
-  bool direct_solver;
+    prm.declare_entry("Coarsening Kelly fraction", "0.0", Patterns::Double(0, 1));
 
-  double force_structure_x_biot, force_structure_y_biot;
-  double force_structure_x, force_structure_y;
+    prm.declare_entry("Load balancing", "none",
+                      Patterns::Selection("none|crack weighted"));
 
-  // Biot parameters
-  double c_biot, alpha_biot, lame_coefficient_biot, K_biot, density_biot;
+    prm.declare_entry("Load imbalance threshold", "1.2", Patterns::Double(1));
 
-  double gravity_x, gravity_y, volume_source, traction_x, traction_y,
-         traction_x_biot, traction_y_biot;
+    prm.declare_entry("value phase field for load balancing", "0.95", Patterns::Double(0));
 
-  // Structure parameters
-  double density_structure;
-  double lame_coefficient_mu, lame_coefficient_lambda, poisson_ratio_nu;
+    prm.declare_entry("Crack cell weight", "0.0", Patterns::Double(0));
 
-  // Other parameters to control the fluid mesh motion
-  double cell_diameter;
+    prm.declare_entry("Output filename", "solution_",
+                      Patterns::Anything());
 
-  FunctionParser<1> func_pressure;
-  double constant_k, alpha_eps,
-         G_c, viscosity_biot, gamma_penal;
+    prm.declare_entry("Output directory", "output",
+                      Patterns::Anything());
 
-  double E_modulus, E_prime;
-  double min_cell_diameter, norm_part_iterations, value_phase_field_for_refinement;
+    prm.declare_entry("Mesh directory", "meshes",
+                      Patterns::Anything());
 
-  unsigned int n_global_pre_refine, n_local_pre_refine, n_refinement_cycles;
+    prm.declare_entry("Probe points", "",
+                      Patterns::Anything());
 
-  double lower_bound_newton_residuum;
-  unsigned int max_no_newton_steps;
-  double upper_newton_rho;
-  unsigned int max_no_line_search_steps;
-  double line_search_damping;
-  double decompose_stress_rhs, decompose_stress_matrix;
-  std::string filename_basis;
-  double old_timestep, old_old_timestep;
-  bool use_old_timestep_pf;
+    prm.declare_entry("Raster output resolution", "0",
+                      Patterns::Integer(0));
 
+    prm.declare_entry("Crack path output", "false",
+                      Patterns::Bool());
 
-};
+    prm.declare_entry("value phase field for crack path", "0.5",
+                      Patterns::Double(0, 1));
 
-// The constructor of this class is comparable
-// to other tutorials steps, e.g., step-22, and step-31.
-template <int dim>
-FracturePhaseFieldProblem<dim>::FracturePhaseFieldProblem (
-  const unsigned int degree, ParameterHandler &param)
-  :
-  mpi_com(MPI_COMM_WORLD),
-  degree(degree),
-  prm(param),
-  triangulation(mpi_com),
+    prm.declare_entry("Crack components", "false",
+                      Patterns::Bool());
 
-  fe(FE_Q<dim>(degree), dim, FE_Q<dim>(degree), 1),
-  dof_handler(triangulation),
+    prm.declare_entry("value phase field for crack components", "0.5",
+                      Patterns::Double(0, 1));
 
-  pcout(std::cout, (Utilities::MPI::this_mpi_process(mpi_com) == 0)),
-  timer(mpi_com, pcout, TimerOutput::every_call_and_summary,
-        TimerOutput::cpu_and_wall_times)
-{
-}
+    prm.declare_entry("Output profile", "full",
+                      Patterns::Selection("full|standard|minimal"));
 
+    prm.declare_entry("Output crack region only", "false",
+                      Patterns::Bool());
 
+    prm.declare_entry("value phase field for output", "0.95", Patterns::Double(0));
 
-template <int dim>
-void
-FracturePhaseFieldProblem<dim>::declare_parameters (ParameterHandler &prm)
-{
-  prm.enter_subsection("Global parameters");
-  {
-    prm.declare_entry("Global pre-refinement steps", "1",
+    prm.declare_entry("Output background level", "0",
                       Patterns::Integer(0));
 
-    prm.declare_entry("Local pre-refinement steps", "0",
+    prm.declare_entry("Output interval", "1",
                       Patterns::Integer(0));
 
-    prm.declare_entry("Adaptive refinement cycles", "0",
+    prm.declare_entry("Output phase field change", "0.0",
+                      Patterns::Double(0));
+
+    prm.declare_entry("Output active set growth", "0",
                       Patterns::Integer(0));
 
-    prm.declare_entry("Max No of timesteps", "1", Patterns::Integer(0));
+    prm.declare_entry("Output crack energy increase", "0.0",
+                      Patterns::Double(0));
 
-    prm.declare_entry("Timestep size", "1.0", Patterns::Double(0));
+    prm.declare_entry("Output minimal wall time gap", "0.0",
+                      Patterns::Double(0));
 
-    prm.declare_entry("Timestep size to switch to", "1.0", Patterns::Double(0));
+    prm.declare_entry("Output mode", "per rank",
+                      Patterns::Selection("per rank|vtu in parallel|hdf5"));
 
-    prm.declare_entry("Switch timestep after steps", "0", Patterns::Integer(0));
+    prm.declare_entry("Output groups", "1",
+                      Patterns::Integer(1));
 
-    prm.declare_entry("outer solver", "active set",
-                      Patterns::Selection("active set|simple monolithic"));
+    prm.declare_entry("Output compression", "best compression",
+                      Patterns::Selection("none|best speed|default|best compression"));
 
-    prm.declare_entry("test case", "sneddon 2d", Patterns::Selection("sneddon 2d|miehe tension|miehe shear|multiple homo|multiple het"));
+    prm.declare_entry("Asynchronous output", "false",
+                      Patterns::Bool());
 
-    prm.declare_entry("ref strategy", "phase field",
-                      Patterns::Selection("phase field|fixed preref sneddon|fixed preref miehe tension|fixed preref miehe shear|fixed preref multiple homo|fixed preref multiple het|global|mix"));
+    prm.declare_entry("Output queue length", "2",
+                      Patterns::Integer(1));
 
-    prm.declare_entry("value phase field for refinement", "0.0", Patterns::Double(0));
+    prm.declare_entry("Checkpoint interval", "0",
+                      Patterns::Integer(0));
 
-    prm.declare_entry("Output filename", "solution_",
+    prm.declare_entry("Checkpoints kept", "2",
+                      Patterns::Integer(1));
+
+    prm.declare_entry("Restart from checkpoint", "",
+                      Patterns::Anything());
+
+    prm.declare_entry("Mesh cache directory", "",
                       Patterns::Anything());
   }
   prm.leave_subsection();
@@ -1016,6 +1160,27 @@ FracturePhaseFieldProblem<dim>::declare_parameters (ParameterHandler &prm)
     prm.declare_entry("Line search damping", "0.5",
                       Patterns::Double(0));
 
+    prm.declare_entry("Line search mode", "backtracking",
+                      Patterns::Selection("backtracking|batched"));
+
+    prm.declare_entry("Line search batch size", "4",
+                      Patterns::Integer(1));
+
+    prm.declare_entry("Elastic predictor", "false",
+                      Patterns::Bool());
+
+    prm.declare_entry("Newton initial guess", "previous",
+                      Patterns::Selection("previous|linear"));
+
+    prm.declare_entry("Extrapolate phase field", "false",
+                      Patterns::Bool());
+
+    prm.declare_entry("DoF renumbering", "none",
+                      Patterns::Selection("none|Cuthill-McKee"));
+
+    prm.declare_entry("DoF renumbering benchmark", "false",
+                      Patterns::Bool());
+
     prm.declare_entry("Decompose stress in rhs", "0.0",
                       Patterns::Double(0));
 
@@ -1046,6 +1211,27 @@ FracturePhaseFieldProblem<dim>::set_runtime_parameters ()
   timestep_size_2 = prm.get_double("Timestep size to switch to");
   switch_timestep = prm.get_integer("Switch timestep after steps");
 
+  // Fixed: the step sizes given above, cut by a factor of 10
+  // if Newton's method fails
+  // Adaptive: the step size is controlled by the Newton effort
+  // and the change of the phase field of the previous step
+  if (prm.get("Timestep control")=="fixed")
+    timestep_control = TimestepControl::fixed;
+  else if (prm.get("Timestep control")=="adaptive")
+    timestep_control = TimestepControl::adaptive;
+  min_timestep = prm.get_double("Minimal timestep size");
+  max_timestep = prm.get_double("Maximal timestep size");
+  timestep_growth_limit = prm.get_double("Timestep growth limit");
+  target_newton_iterations = prm.get_integer("Target Newton iterations");
+  target_pf_change = prm.get_double("Target phase-field change");
+  old_timestep_indicator = 1.0;
+
+  newton_iterations = 0;
+  active_set_changes = 0;
+  step_newton_iterations = 0;
+  total_newton_iterations = 0;
+  rejected_newton_iterations = 0;
+
   if (prm.get("outer solver")=="active set")
     outer_solver = OuterSolverType::active_set;
   else if (prm.get("outer solver")=="simple monolithic")
@@ -1064,6 +1250,10 @@ FracturePhaseFieldProblem<dim>::set_runtime_parameters ()
   else
     AssertThrow(false, ExcNotImplemented());
 
+  // .pgm image of the E modulus distribution of the heterogeneous test,
+  // relative to the mesh directory unless given as an absolute path
+  emodulus_bitmap = prm.get("E modulus bitmap");
+
   if (prm.get("ref strategy")=="phase field")
     refinement_strategy = RefinementStrategy::phase_field_ref;
   else if (prm.get("ref strategy")=="fixed preref sneddon")
@@ -1086,8 +1276,189 @@ FracturePhaseFieldProblem<dim>::set_runtime_parameters ()
   value_phase_field_for_refinement
     = prm.get_double("value phase field for refinement");
 
+  // Refine flagged regions up to the finest level in one adaptation
+  // (several refinement passes without solving in between) instead of
+  // one level per time step
+  refine_to_target_level = prm.get_bool("Refine to target level");
+  n_redone_steps = 0;
+
+  // Additionally refine where the crack is expected next: where the
+  // crack driving force will push the phase field below the refinement
+  // value, or where the phase field extrapolated with its rate of the
+  // last step drops below it. All cells within the band width around
+  // these cells are refined as well.
+  if (prm.get("Predictive refinement")=="none")
+    predictive_refinement = PredictiveRefinement::none;
+  else if (prm.get("Predictive refinement")=="driving force")
+    predictive_refinement = PredictiveRefinement::driving_force;
+  else if (prm.get("Predictive refinement")=="phase field rate")
+    predictive_refinement = PredictiveRefinement::phase_field_rate;
+  predictive_refinement_band_width = prm.get_double("Predictive refinement band width");
+
+  // Coarsen cells (down to the globally refined level) that are farther
+  // than the coarsening distance away from the crack band, i.e., cells
+  // with phase field below the coarsening value in the current or old
+  // solution. If a Kelly fraction is given, only that fraction of cells
+  // with the lowest Kelly indicator of the displacements is coarsened
+  // there. Only used with the "phase field" and "mix" strategies.
+  coarsen_mesh = prm.get_bool("Coarsening");
+  coarsening_distance = prm.get_double("Coarsening distance");
+  value_phase_field_for_coarsening = prm.get_double("value phase field for coarsening");
+  coarsening_kelly_fraction = prm.get_double("Coarsening Kelly fraction");
+
+  // Crack weighted: cells with phase field below the given value are
+  // weighted with their assembly cost relative to intact cells when the
+  // mesh is partitioned. A crack cell weight of 0 means the cost is
+  // measured during the assembly. The mesh is repartitioned if the
+  // assembly time of the slowest processor exceeds the average by the
+  // imbalance threshold.
+  if (prm.get("Load balancing")=="none")
+    load_balancing = LoadBalancing::none;
+  else if (prm.get("Load balancing")=="crack weighted")
+    load_balancing = LoadBalancing::crack_weighted;
+  load_imbalance_threshold = prm.get_double("Load imbalance threshold");
+  value_phase_field_for_load_balancing = prm.get_double("value phase field for load balancing");
+  crack_cell_weight = prm.get_double("Crack cell weight");
+  measure_crack_cell_weight = (crack_cell_weight == 0.0);
+  if (measure_crack_cell_weight)
+    crack_cell_weight = 1.0;
+  assembly_time_crack = assembly_time_intact = 0.0;
+  n_assembled_crack = n_assembled_intact = 0;
+  n_repartitions = 0;
+
   filename_basis  = prm.get ("Output filename");
 
+  // Directories the output is written to and the meshes are read from,
+  // relative to the working directory unless given as absolute paths
+  output_directory = prm.get("Output directory");
+  mesh_directory = prm.get("Mesh directory");
+
+  // Full: solution as vector and scalars, subdomain, active set and
+  // the test case specific fields
+  // Standard: displacements and phase field once, active set and the
+  // test case specific fields
+  // Minimal: phase field only
+  // The VTU writer of deal.II stores all fields as Float32. The HDF5
+  // writer stores them in double precision; this is not reduced.
+  if (prm.get("Output profile")=="full")
+    output_profile = OutputProfile::full;
+  else if (prm.get("Output profile")=="standard")
+    output_profile = OutputProfile::standard;
+  else if (prm.get("Output profile")=="minimal")
+    output_profile = OutputProfile::minimal;
+
+  // Only write the cells with phase field below the given value and,
+  // as background, all cells up to the given refinement level
+  output_crack_region_only = prm.get_bool("Output crack region only");
+  value_phase_field_for_output = prm.get_double("value phase field for output");
+  output_background_level = prm.get_integer("Output background level");
+
+  // Write a snapshot at least every given number of steps (0: only on
+  // events) and whenever, since the last snapshot, the maximal change
+  // of the phase field, the growth of the active set (number of DoFs)
+  // or the relative increase of the crack energy exceed the given
+  // values (0: not used). Snapshots on events are at least the given
+  // number of seconds apart.
+  // The defaults write every step.
+  output_interval = prm.get_integer("Output interval");
+  output_phase_field_change = prm.get_double("Output phase field change");
+  output_active_set_growth = prm.get_integer("Output active set growth");
+  output_crack_energy_increase = prm.get_double("Output crack energy increase");
+  output_min_wall_time = prm.get_double("Output minimal wall time gap");
+  output_reference_valid = false;
+  crack_energy = 0.0;
+
+  // Per rank: one .vtu file per processor and step
+  // Vtu in parallel: the processors are split into the given number of
+  // groups, each group writes one .vtu file per step
+  // Hdf5: one .h5 file per step and an XDMF time series
+  if (prm.get("Output mode")=="per rank")
+    output_mode = OutputMode::per_rank;
+  else if (prm.get("Output mode")=="vtu in parallel")
+    output_mode = OutputMode::vtu_in_parallel;
+  else if (prm.get("Output mode")=="hdf5")
+    output_mode = OutputMode::hdf5;
+  output_n_groups = prm.get_integer("Output groups");
+  output_group_com = MPI_COMM_NULL;
+  xdmf_entries.clear();
+
+  // zlib compression level of the .vtu files. The data arrays are
+  // compressed in blocks on all threads.
+  if (prm.get("Output compression")=="none")
+    output_compression = DataOutBase::VtkFlags::no_compression;
+  else if (prm.get("Output compression")=="best speed")
+    output_compression = DataOutBase::VtkFlags::best_speed;
+  else if (prm.get("Output compression")=="default")
+    output_compression = DataOutBase::VtkFlags::default_compression;
+  else if (prm.get("Output compression")=="best compression")
+    output_compression = DataOutBase::VtkFlags::best_compression;
+
+  // Write the output files on a background thread while the
+  // computation goes on. At most the given number of outputs are
+  // pending, 2 means double buffering. Only used for per rank output,
+  // the other modes write collectively.
+  async_output = prm.get_bool("Asynchronous output");
+  output_queue_length = prm.get_integer("Output queue length");
+  output_cycle = -1;
+
+  // Save mesh, solutions and time stepping state every given number of
+  // time steps (0: never) as output/<basis>checkpoint-NNNNN, keeping the
+  // given number of the last checkpoints. A run is continued from the
+  // checkpoint given (without the file endings), also on a different
+  // number of processors.
+  checkpoint_interval = prm.get_integer("Checkpoint interval");
+  n_checkpoints_kept = prm.get_integer("Checkpoints kept");
+  checkpoint_names.clear();
+  restart_checkpoint = prm.get("Restart from checkpoint");
+  new_probe_file = restart_checkpoint.empty();
+  new_crack_component_file = restart_checkpoint.empty();
+  output_file_names_by_timestep.clear();
+  n_cod_files = n_cod_array_files = 0;
+
+  // Directory to store the pre-refined mesh and the initial solution in
+  // and to take them from in later runs with the same mesh, refinement
+  // and initial crack parameters (empty: no cache)
+  mesh_cache_directory = prm.get("Mesh cache directory");
+
+  // Sensor points "x1,y1; x2,y2; ...": displacements and phase field
+  // at these points are written after each time step
+  probe_points.clear();
+  {
+    const std::vector<std::string> points
+      = Utilities::split_string_list(prm.get("Probe points"), ';');
+    for (unsigned int i = 0; i < points.size(); ++i)
+      {
+        const std::vector<double> coordinates
+          = Utilities::string_to_double(Utilities::split_string_list(points[i], ','));
+        AssertThrow(coordinates.size() == dim,
+                    ExcMessage("Probe point '" + points[i] + "' does not have " +
+                               Utilities::int_to_string(dim) + " coordinates"));
+        Point<dim> point;
+        for (unsigned int d = 0; d < dim; ++d)
+          point[d] = coordinates[d];
+        probe_points.push_back(point);
+      }
+  }
+  probes_valid = false;
+
+  // Phase field sampled on a pixel grid of the given resolution over
+  // the domain and written as .pgm image after each time step (0: no
+  // images)
+  raster_resolution = prm.get_integer("Raster output resolution");
+
+  // Extract the isoline of the phase field at the given value after
+  // each time step, write it as polylines and print length and tips
+  // of the cracks
+  crack_path_output = prm.get_bool("Crack path output");
+  value_phase_field_for_crack_path = prm.get_double("value phase field for crack path");
+
+  // Label the connected sets of cells whose mean phase field is below
+  // the given value after each time step and print area, bounding box
+  // and crack energy of each, and when cracks merge
+  crack_components_output = prm.get_bool("Crack components");
+  value_phase_field_for_crack_components = prm.get_double("value phase field for crack components");
+  crack_component_points.clear();
+
   prm.leave_subsection();
 
   prm.enter_subsection("Problem dependent parameters");
@@ -1157,23 +1528,63 @@ FracturePhaseFieldProblem<dim>::set_runtime_parameters ()
   if (test_case == TestCase::sneddon_2d ||
       test_case == TestCase::multiple_homo ||
       test_case == TestCase::multiple_het)
-    grid_name = "meshes/unit_square_4.inp";
+    grid_name = mesh_directory + "/unit_square_4.inp";
   else
-    grid_name  = "meshes/unit_slit.inp";
+    grid_name  = mesh_directory + "/unit_slit.inp";
 
   GridIn<dim> grid_in;
   grid_in.attach_triangulation(triangulation);
   std::ifstream input_file(grid_name.c_str());
+  AssertThrow(input_file, ExcMessage("Could not open the mesh file " + grid_name));
   Assert(dim==2, ExcInternalError());
   grid_in.read_ucd(input_file);
 
-  triangulation.refine_global(n_global_pre_refine);
+  // A cache entry is complete once its .key file is written. The key
+  // starts with the tag of the entry's files, read on the first
+  // processor only, as another run may replace the key meanwhile.
+  mesh_cache_name.clear();
+  mesh_cache_hit = false;
+  if (!mesh_cache_directory.empty() && restart_checkpoint.empty())
+    {
+      mesh_cache_parameters = mesh_cache_key(grid_name);
+      std::ostringstream name;
+      name << mesh_cache_directory << "/mesh-"
+           << std::hex << std::setw(16) << std::setfill('0')
+           << fnv1a_hash(mesh_cache_parameters);
+      mesh_cache_name = name.str();
+
+      unsigned long long entry[2] = {0, 0};
+      if (Utilities::MPI::this_mpi_process(mpi_com) == 0)
+        {
+          std::ifstream key_file((mesh_cache_name + ".key").c_str());
+          std::string tag;
+          std::ostringstream stored_key;
+          if (key_file && std::getline(key_file, tag))
+            {
+              stored_key << key_file.rdbuf();
+              if (stored_key.str() == mesh_cache_parameters)
+                {
+                  entry[0] = 1;
+                  entry[1] = std::strtoull(tag.c_str(), NULL, 16);
+                }
+            }
+        }
+      MPI_Bcast(entry, 2, MPI_UNSIGNED_LONG_LONG, 0, mpi_com);
+      mesh_cache_hit = (entry[0] == 1);
+      mesh_cache_tag = entry[1];
+    }
+
+  // The refinement of a restart or a cached mesh is loaded later
+  if (restart_checkpoint.empty() && !mesh_cache_hit)
+    triangulation.refine_global(n_global_pre_refine);
 
   pcout << "Cells:\t" << triangulation.n_active_cells() << std::endl;
 
 
   if (test_case == TestCase::multiple_het)
-    func_emodulus = new BitmapFunction<dim>("test.pgm",0,4,0,4,E_modulus,10.0*E_modulus);
+    func_emodulus = new BitmapFunction<dim>(
+      (emodulus_bitmap[0] == '/') ? emodulus_bitmap : mesh_directory + "/" + emodulus_bitmap,
+      0,4,0,4,E_modulus,10.0*E_modulus);
 
 
 
@@ -1194,6 +1605,42 @@ FracturePhaseFieldProblem<dim>::set_runtime_parameters ()
   max_no_line_search_steps = prm.get_integer("Line search maximum steps");
   line_search_damping = prm.get_double("Line search damping");
 
+  // Batched: evaluate the residual for several damping factors
+  // in a single sweep over the mesh
+  if (prm.get("Line search mode")=="backtracking")
+    line_search_mode = LineSearchMode::backtracking;
+  else if (prm.get("Line search mode")=="batched")
+    line_search_mode = LineSearchMode::batched;
+  line_search_batch_size = prm.get_integer("Line search batch size");
+  n_residual_assemblies = 0;
+
+  // Solve the elasticity problem with frozen phase field first and
+  // skip the coupled Newton method if the phase field stays admissible.
+  // Only used with the active set method.
+  use_elastic_predictor = prm.get_bool("Elastic predictor");
+  n_elastic_predictor_steps = 0;
+
+  // Previous: start Newton's method from the last converged solution
+  // Linear: extrapolate from the last two time steps
+  if (prm.get("Newton initial guess")=="previous")
+    initial_guess = InitialGuess::previous;
+  else if (prm.get("Newton initial guess")=="linear")
+    initial_guess = InitialGuess::linear;
+  extrapolate_phase_field = prm.get_bool("Extrapolate phase field");
+
+  // Order of the locally owned DoFs within the displacement and the
+  // phase-field block. None: order of the cell traversal, Cuthill-McKee:
+  // reduce the bandwidth of the local matrix. The cells of the
+  // distributed triangulation are already traversed in the Z order of
+  // p4est, so a hierarchical renumbering would not change anything.
+  // The benchmark compares the assembly and matrix-vector product
+  // times of both.
+  if (prm.get("DoF renumbering")=="none")
+    dof_renumbering = DoFRenumberingType::none;
+  else if (prm.get("DoF renumbering")=="Cuthill-McKee")
+    dof_renumbering = DoFRenumberingType::cuthill_mckee;
+  dof_renumbering_benchmark = prm.get_bool("DoF renumbering benchmark");
+
   // Decompose stress in plus (tensile) and minus (compression)
   // 0.0: no decomposition, 1.0: with decomposition
   // Motivation see Miehe et al. (2010)
@@ -1219,6 +1666,12 @@ FracturePhaseFieldProblem<dim>::setup_system ()
 
   dof_handler.distribute_dofs(fe);
 
+  // The component wise renumbering keeps the order within each
+  // component, so this renumbering is applied inside the blocks
+  // of the locally owned range
+  if (dof_renumbering == DoFRenumberingType::cuthill_mckee)
+    DoFRenumbering::Cuthill_McKee (dof_handler);
+
   std::vector<unsigned int> sub_blocks (dim+1,0);
   sub_blocks[dim] = 1;
   DoFRenumbering::component_wise (dof_handler, sub_blocks);
@@ -1289,29 +1742,34 @@ FracturePhaseFieldProblem<dim>::setup_system ()
   }
 
   // Actual solution at time step n
-  solution.reinit(partition);
+  solution.reinit(partition, mpi_com);
 
   // Old timestep solution at time step n-1
-  old_solution.reinit(partition_relevant);
+  old_solution.reinit(partition_relevant, mpi_com);
 
   // Old timestep solution at time step n-2
-  old_old_solution.reinit(partition_relevant);
+  old_old_solution.reinit(partition_relevant, mpi_com);
 
   // Updates for Newton's method
-  newton_update.reinit(partition);
+  newton_update.reinit(partition, mpi_com);
 
   // Residual for  Newton's method
-  system_pde_residual.reinit(partition);
+  system_pde_residual.reinit(partition, mpi_com);
 
-  system_total_residual.reinit(partition);
+  system_total_residual.reinit(partition, mpi_com);
 
-  diag_mass.reinit(partition);
-  diag_mass_relevant.reinit(partition_relevant);
+  diag_mass.reinit(partition, mpi_com);
+  diag_mass_relevant.reinit(partition_relevant, mpi_com);
   assemble_diag_mass_matrix();
 
   active_set.clear();
   active_set.set_size(dof_handler.n_dofs());
 
+  cell_buckets.clear();
+  cell_buckets_valid = false;
+  boundary_faces.clear();
+  boundary_faces_valid = false;
+  output_reference_valid = false;
 }
 
 
@@ -1574,9 +2032,11 @@ void decompose_stress(
 
 // In this function, we assemble the Jacobian matrix
 // for the Newton iteration.
+// If elasticity_only is set, only the preconditioner of the
+// displacement block is set up (see elastic_predictor()).
 template <int dim>
 void
-FracturePhaseFieldProblem<dim>::assemble_system (bool residual_only)
+FracturePhaseFieldProblem<dim>::assemble_system (bool residual_only, bool elasticity_only)
 {
   if (residual_only)
     system_total_residual = 0;
@@ -1593,15 +2053,15 @@ FracturePhaseFieldProblem<dim>::assemble_system (bool residual_only)
   const double current_pressure = func_pressure.value(Point<1>(time), 0);
 
   LA::MPI::BlockVector rel_solution(
-    partition_relevant);
+    partition_relevant, mpi_com);
   rel_solution = solution;
 
   LA::MPI::BlockVector rel_old_solution(
-    partition_relevant);
+    partition_relevant, mpi_com);
   rel_old_solution = old_solution;
 
   LA::MPI::BlockVector rel_old_old_solution(
-    partition_relevant);
+    partition_relevant, mpi_com);
   rel_old_old_solution = old_old_solution;
 
   QGauss<dim> quadrature_formula(degree + 2);
@@ -1649,9 +2109,21 @@ FracturePhaseFieldProblem<dim>::assemble_system (bool residual_only)
   Tensor<2,dim> zero_matrix;
   zero_matrix.clear();
 
+  // The cells are timed one by one for the crack weighted load
+  // balancing only, otherwise the whole loop is timed
+  const bool time_cells = (load_balancing == LoadBalancing::crack_weighted);
+  const std::chrono::steady_clock::time_point assembly_start
+    = std::chrono::steady_clock::now();
+
   for (; cell != endc; ++cell)
     if (cell->is_locally_owned())
       {
+        // cost of this cell for the load balancing
+        std::chrono::steady_clock::time_point cell_start;
+        if (time_cells)
+          cell_start = std::chrono::steady_clock::now();
+        bool crack_cell = false;
+
         fe_values.reinit(cell);
 
         // update lame coefficients based on current cell
@@ -1708,23 +2180,10 @@ FracturePhaseFieldProblem<dim>::assemble_system (bool residual_only)
               double pf_minus_old_timestep_pf_plus =
                 std::max(0.0, pf - old_timestep_pf);
 
-              double pf_extra = pf;
-              // Linearization by extrapolation to cope with non-convexity of the underlying
-              // energy functional.
-              // This idea might be refined in a future work (be also careful because
-              // theoretically, we do not have time regularity; therefore extrapolation in time
-              // might be questionable. But for the time being, this is numerically robust.
-              pf_extra = old_old_timestep_pf + (time - (time-old_timestep-old_old_timestep))/
-                         (time-old_timestep - (time-old_timestep-old_old_timestep)) * (old_timestep_pf - old_old_timestep_pf);
-              if (pf_extra <= 0.0)
-                pf_extra = 0.0;
-              if (pf_extra >= 1.0)
-                pf_extra = 1.0;
-
-
-              if (use_old_timestep_pf)
-                pf_extra = old_timestep_pf;
+              if (pf < value_phase_field_for_load_balancing)
+                crack_cell = true;
 
+              const double pf_extra = extrapolated_pf(old_timestep_pf, old_old_timestep_pf);
 
               const Tensor<2,dim> grad_u = Tensors
                                            ::get_grad_u<dim> (q, old_solution_grads);
@@ -1840,44 +2299,11 @@ FracturePhaseFieldProblem<dim>::assemble_system (bool residual_only)
 
 
               // RHS:
-              for (unsigned int i = 0; i < dofs_per_cell; ++i)
-                {
-                  const unsigned int comp_i = fe.system_to_component_index(i).first;
-                  if (comp_i < dim)
-                    {
-                      const Tensor<2, dim> phi_i_grads_u =
-                        fe_values[displacements].gradient(i, q);
-
-                      // Solid
-                      local_rhs(i) -=
-                        (scalar_product(((1.0-constant_k) * pf_extra * pf_extra + constant_k) *
-                                        stress_term_plus, phi_i_grads_u)
-                         +  decompose_stress_rhs * scalar_product(stress_term_minus, phi_i_grads_u)
-                         // Pressure terms
-                         - (alpha_biot - 1.0) * current_pressure * pf_extra * pf_extra * (phi_i_grads_u[0][0] + phi_i_grads_u[1][1])
-                        ) * fe_values.JxW(q);
-
-                    }
-                  else if (comp_i == dim)
-                    {
-                      const double phi_i_pf = fe_values[phase_field].value (i, q);
-                      const Tensor<1,dim> phi_i_grads_pf = fe_values[phase_field].gradient (i, q);
-
-                      // Simple penalization
-                      local_rhs(i) -= gamma_penal/timestep * 1.0/(cell->diameter() * cell->diameter()) *
-                                      pf_minus_old_timestep_pf_plus * phi_i_pf * fe_values.JxW(q);
-
-                      // Phase field
-                      local_rhs(i) -=
-                        ((1.0 - constant_k) * scalar_product(stress_term_plus, E) * pf * phi_i_pf
-                         - G_c/alpha_eps * (1.0 - pf) * phi_i_pf
-                         + G_c * alpha_eps * grad_pf * phi_i_grads_pf
-                         // Pressure terms
-                         - 2.0 * (alpha_biot - 1.0) * current_pressure * pf * divergence_u * phi_i_pf
-                        ) * fe_values.JxW(q);
-                    }
-
-                } // end i
+              add_local_residual(fe_values, q, cell->diameter(), current_pressure,
+                                 pf, pf_extra, pf_minus_old_timestep_pf_plus,
+                                 grad_pf, divergence_u, E,
+                                 stress_term_plus, stress_term_minus,
+                                 local_rhs);
 
 
 
@@ -1912,9 +2338,29 @@ FracturePhaseFieldProblem<dim>::assemble_system (bool residual_only)
             }
           // end if (second PDE: STVK material)
         }
+
+        if (time_cells)
+          {
+            const double cell_time = std::chrono::duration<double>(
+                                       std::chrono::steady_clock::now() - cell_start).count();
+            if (crack_cell)
+              {
+                assembly_time_crack += cell_time;
+                ++n_assembled_crack;
+              }
+            else
+              {
+                assembly_time_intact += cell_time;
+                ++n_assembled_intact;
+              }
+          }
         // end cell
       }
 
+  if (!time_cells)
+    assembly_time_intact += std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - assembly_start).count();
+
   if (residual_only)
     system_total_residual.compress(VectorOperation::add);
   else
@@ -1933,15 +2379,16 @@ FracturePhaseFieldProblem<dim>::assemble_system (bool residual_only)
         data.aggregation_threshold = 0.02;
         preconditioner_solid.initialize(system_pde_matrix.block(0, 0), data);
       }
-      {
-        LA::MPI::PreconditionAMG::AdditionalData data;
-        //data.constant_modes = constant_modes;
-        data.elliptic = true;
-        data.higher_order_elements = true;
-        data.smoother_sweeps = 2;
-        data.aggregation_threshold = 0.02;
-        preconditioner_phase_field.initialize(system_pde_matrix.block(1, 1), data);
-      }
+      if (!elasticity_only)
+        {
+          LA::MPI::PreconditionAMG::AdditionalData data;
+          //data.constant_modes = constant_modes;
+          data.elliptic = true;
+          data.higher_order_elements = true;
+          data.smoother_sweeps = 2;
+          data.aggregation_threshold = 0.02;
+          preconditioner_phase_field.initialize(system_pde_matrix.block(1, 1), data);
+        }
     }
 }
 
@@ -1956,9 +2403,298 @@ template <int dim>
 void
 FracturePhaseFieldProblem<dim>::assemble_nl_residual ()
 {
+  ++n_residual_assemblies;
   assemble_system(true);
 }
 
+
+// Linearization by extrapolation to cope with non-convexity of the underlying
+// energy functional.
+// This idea might be refined in a future work (be also careful because
+// theoretically, we do not have time regularity; therefore extrapolation in time
+// might be questionable. But for the time being, this is numerically robust.
+template <int dim>
+double
+FracturePhaseFieldProblem<dim>::extrapolated_pf (
+  const double old_timestep_pf,
+  const double old_old_timestep_pf) const
+{
+  if (use_old_timestep_pf)
+    return old_timestep_pf;
+
+  double pf_extra = old_old_timestep_pf + (time - (time-old_timestep-old_old_timestep))/
+                    (time-old_timestep - (time-old_timestep-old_old_timestep)) * (old_timestep_pf - old_old_timestep_pf);
+  if (pf_extra <= 0.0)
+    pf_extra = 0.0;
+  if (pf_extra >= 1.0)
+    pf_extra = 1.0;
+
+  return pf_extra;
+}
+
+
+// The residual contributions of one quadrature point. The quantities
+// depending on the current iterate are evaluated by the caller, such
+// that assemble_system() and the batched line search share the same terms.
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::add_local_residual (
+  const FEValues<dim> &fe_values,
+  const unsigned int q,
+  const double cell_diameter,
+  const double current_pressure,
+  const double pf,
+  const double pf_extra,
+  const double pf_minus_old_timestep_pf_plus,
+  const Tensor<1,dim> &grad_pf,
+  const double divergence_u,
+  const Tensor<2,dim> &E,
+  const Tensor<2,dim> &stress_term_plus,
+  const Tensor<2,dim> &stress_term_minus,
+  Vector<double> &local_rhs) const
+{
+  const FEValuesExtractors::Vector displacements(0);
+  const FEValuesExtractors::Scalar phase_field (dim);
+
+  for (unsigned int i = 0; i < fe.dofs_per_cell; ++i)
+    {
+      const unsigned int comp_i = fe.system_to_component_index(i).first;
+      if (comp_i < dim)
+        {
+          const Tensor<2, dim> phi_i_grads_u =
+            fe_values[displacements].gradient(i, q);
+
+          // Solid
+          local_rhs(i) -=
+            (scalar_product(((1.0-constant_k) * pf_extra * pf_extra + constant_k) *
+                            stress_term_plus, phi_i_grads_u)
+             +  decompose_stress_rhs * scalar_product(stress_term_minus, phi_i_grads_u)
+             // Pressure terms
+             - (alpha_biot - 1.0) * current_pressure * pf_extra * pf_extra * (phi_i_grads_u[0][0] + phi_i_grads_u[1][1])
+            ) * fe_values.JxW(q);
+
+        }
+      else if (comp_i == dim)
+        {
+          const double phi_i_pf = fe_values[phase_field].value (i, q);
+          const Tensor<1,dim> phi_i_grads_pf = fe_values[phase_field].gradient (i, q);
+
+          // Simple penalization
+          local_rhs(i) -= gamma_penal/timestep * 1.0/(cell_diameter * cell_diameter) *
+                          pf_minus_old_timestep_pf_plus * phi_i_pf * fe_values.JxW(q);
+
+          // Phase field
+          local_rhs(i) -=
+            ((1.0 - constant_k) * scalar_product(stress_term_plus, E) * pf * phi_i_pf
+             - G_c/alpha_eps * (1.0 - pf) * phi_i_pf
+             + G_c * alpha_eps * grad_pf * phi_i_grads_pf
+             // Pressure terms
+             - 2.0 * (alpha_biot - 1.0) * current_pressure * pf * divergence_u * phi_i_pf
+            ) * fe_values.JxW(q);
+        }
+
+    } // end i
+}
+
+
+// Assemble the nonlinear residual at the trial points
+// solution + alphas[k] * newton_update for all k in a single
+// sweep over the mesh. FEValues::reinit(), the shape functions
+// and the gathers of the old time step values are shared by all
+// damping factors. The result for alphas[k] is written into
+// pde_residuals[k] and total_residuals[k], which correspond to
+// system_pde_residual and system_total_residual in assemble_system().
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::assemble_nl_residual_batch (
+  const std::vector<double> &alphas,
+  std::vector<LA::MPI::BlockVector> &pde_residuals,
+  std::vector<LA::MPI::BlockVector> &total_residuals)
+{
+  ++n_residual_assemblies;
+
+  const unsigned int n_alphas = alphas.size();
+  for (unsigned int k = 0; k < n_alphas; ++k)
+    {
+      pde_residuals[k] = 0;
+      total_residuals[k] = 0;
+    }
+
+  if ((outer_solver == OuterSolverType::simple_monolithic) && (timestep_number < 1))
+    {
+      gamma_penal = 0.0;
+    }
+  const double current_pressure = func_pressure.value(Point<1>(time), 0);
+
+  LA::MPI::BlockVector rel_solution(
+    partition_relevant, mpi_com);
+  rel_solution = solution;
+
+  LA::MPI::BlockVector rel_update(
+    partition_relevant, mpi_com);
+  rel_update = newton_update;
+
+  LA::MPI::BlockVector rel_old_solution(
+    partition_relevant, mpi_com);
+  rel_old_solution = old_solution;
+
+  LA::MPI::BlockVector rel_old_old_solution(
+    partition_relevant, mpi_com);
+  rel_old_old_solution = old_old_solution;
+
+  QGauss<dim> quadrature_formula(degree + 2);
+
+  FEValues<dim> fe_values(fe, quadrature_formula,
+                          update_values | update_quadrature_points | update_JxW_values
+                          | update_gradients);
+
+  const unsigned int dofs_per_cell = fe.dofs_per_cell;
+
+  const unsigned int n_q_points = quadrature_formula.size();
+
+  std::vector<Vector<double> > local_rhs(n_alphas, Vector<double>(dofs_per_cell));
+
+  std::vector<unsigned int> local_dof_indices(dofs_per_cell);
+
+  std::vector<Vector<double> > solution_values(n_q_points,
+                                               Vector<double>(dim+1));
+  std::vector<std::vector<Tensor<1,dim> > > solution_grads (n_q_points,
+      std::vector<Tensor<1,dim> > (dim+1));
+
+  std::vector<Vector<double> > update_values(n_q_points,
+                                             Vector<double>(dim+1));
+  std::vector<std::vector<Tensor<1,dim> > > update_grads (n_q_points,
+      std::vector<Tensor<1,dim> > (dim+1));
+
+  std::vector<Vector<double> > old_timestep_solution_values(n_q_points,
+                                                            Vector<double>(dim+1));
+  std::vector<Vector<double> > old_old_timestep_solution_values(n_q_points,
+      Vector<double>(dim+1));
+
+  // values at the trial point of the current damping factor
+  std::vector<Vector<double> > trial_values(n_q_points,
+                                            Vector<double>(dim+1));
+  std::vector<std::vector<Tensor<1,dim> > > trial_grads (n_q_points,
+      std::vector<Tensor<1,dim> > (dim+1));
+
+  const Tensor<2,dim> Identity = Tensors
+                                 ::get_Identity<dim> ();
+  Tensor<2,dim> zero_matrix;
+  zero_matrix.clear();
+
+  typename DoFHandler<dim>::active_cell_iterator cell =
+    dof_handler.begin_active(), endc = dof_handler.end();
+
+  for (; cell != endc; ++cell)
+    if (cell->is_locally_owned())
+      {
+        fe_values.reinit(cell);
+
+        if (test_case == TestCase::multiple_het)
+          {
+            E_modulus = func_emodulus->value(cell->center(), 0);
+            E_modulus += 1.0;
+
+            lame_coefficient_mu = E_modulus / (2.0 * (1 + poisson_ratio_nu));
+
+            lame_coefficient_lambda = (2 * poisson_ratio_nu * lame_coefficient_mu)
+                                      / (1.0 - 2 * poisson_ratio_nu);
+          }
+
+        fe_values.get_function_values (rel_solution, solution_values);
+        fe_values.get_function_gradients (rel_solution, solution_grads);
+        fe_values.get_function_values (rel_update, update_values);
+        fe_values.get_function_gradients (rel_update, update_grads);
+        fe_values.get_function_values (rel_old_solution, old_timestep_solution_values);
+        fe_values.get_function_values (rel_old_old_solution, old_old_timestep_solution_values);
+
+        for (unsigned int k = 0; k < n_alphas; ++k)
+          {
+            local_rhs[k] = 0;
+
+            for (unsigned int q = 0; q < n_q_points; ++q)
+              {
+                trial_values[q] = solution_values[q];
+                trial_values[q].add(alphas[k], update_values[q]);
+                for (unsigned int c = 0; c < dim+1; ++c)
+                  trial_grads[q][c] = solution_grads[q][c] + alphas[k] * update_grads[q][c];
+              }
+
+            for (unsigned int q = 0; q < n_q_points; ++q)
+              {
+                double pf = trial_values[q](dim);
+                double old_timestep_pf = old_timestep_solution_values[q](dim);
+                double old_old_timestep_pf = old_old_timestep_solution_values[q](dim);
+                if (outer_solver == OuterSolverType::simple_monolithic)
+                  {
+                    pf = std::max(0.0,trial_values[q](dim));
+                    old_timestep_pf = std::max(0.0,old_timestep_solution_values[q](dim));
+                    old_old_timestep_pf = std::max(0.0,old_old_timestep_solution_values[q](dim));
+                  }
+
+                const double pf_minus_old_timestep_pf_plus =
+                  std::max(0.0, pf - old_timestep_pf);
+
+                const double pf_extra = extrapolated_pf(old_timestep_pf, old_old_timestep_pf);
+
+                const Tensor<2,dim> grad_u = Tensors
+                                             ::get_grad_u<dim> (q, trial_grads);
+
+                const Tensor<1,dim> grad_pf = Tensors
+                                              ::get_grad_pf<dim> (q, trial_grads);
+
+                const double divergence_u = trial_grads[q][0][0] +
+                                            trial_grads[q][1][1];
+
+                const Tensor<2,dim> E = 0.5 * (grad_u + transpose(grad_u));
+                const double tr_E = grad_u[0][0] + grad_u[1][1];
+
+                Tensor<2,dim> stress_term_plus;
+                Tensor<2,dim> stress_term_minus;
+                if (decompose_stress_matrix>0 && timestep_number>0)
+                  {
+                    decompose_stress(stress_term_plus, stress_term_minus,
+                                     E, tr_E, zero_matrix , 0.0,
+                                     lame_coefficient_lambda,
+                                     lame_coefficient_mu, false);
+                  }
+                else
+                  {
+                    stress_term_plus = lame_coefficient_lambda * tr_E * Identity
+                                       + 2 * lame_coefficient_mu * E;
+                    stress_term_minus = 0;
+                  }
+
+                add_local_residual(fe_values, q, cell->diameter(), current_pressure,
+                                   pf, pf_extra, pf_minus_old_timestep_pf_plus,
+                                   grad_pf, divergence_u, E,
+                                   stress_term_plus, stress_term_minus,
+                                   local_rhs[k]);
+              }
+          }
+
+        cell->get_dof_indices(local_dof_indices);
+        for (unsigned int k = 0; k < n_alphas; ++k)
+          {
+            constraints_update.distribute_local_to_global(local_rhs[k],
+                                                          local_dof_indices, pde_residuals[k]);
+
+            if (outer_solver == OuterSolverType::active_set)
+              constraints_hanging_nodes.distribute_local_to_global(local_rhs[k],
+                                                                   local_dof_indices, total_residuals[k]);
+            else
+              constraints_update.distribute_local_to_global(local_rhs[k],
+                                                            local_dof_indices, total_residuals[k]);
+          }
+      }
+
+  for (unsigned int k = 0; k < n_alphas; ++k)
+    {
+      pde_residuals[k].compress(VectorOperation::add);
+      total_residuals[k].compress(VectorOperation::add);
+    }
+}
+
 template <int dim>
 void
 FracturePhaseFieldProblem<dim>::assemble_diag_mass_matrix ()
@@ -2128,6 +2864,61 @@ FracturePhaseFieldProblem<dim>::set_initial_bc (
 
 }
 
+// Initial guess for Newton's method at the new time step, i.e.,
+// solution at time t_n. The displacements are extrapolated linearly from
+// old_solution (t_{n-1}) and old_old_solution (t_{n-2}). The phase field
+// is either kept at its old values or extrapolated as well and then clamped
+// to [0, old value] such that the guess respects the irreversibility.
+// The boundary values are set afterwards by set_initial_bc().
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::set_initial_guess ()
+{
+  solution = old_solution;
+
+  if (initial_guess == InitialGuess::previous
+      || old_old_timestep <= 0.0)
+    return;
+
+  LA::MPI::BlockVector increment(partition, mpi_com);
+  LA::MPI::BlockVector tmp(partition, mpi_com);
+  increment = old_solution;
+  tmp = old_old_solution;
+  increment -= tmp;
+
+  solution.add(timestep/old_old_timestep, increment);
+
+  typename DoFHandler<dim>::active_cell_iterator cell =
+    dof_handler.begin_active(), endc = dof_handler.end();
+
+  std::vector<unsigned int> local_dof_indices(fe.dofs_per_cell);
+  for (; cell != endc; ++cell)
+    if (cell->is_locally_owned())
+      {
+        cell->get_dof_indices(local_dof_indices);
+        for (unsigned int i=0; i<fe.dofs_per_cell; ++i)
+          {
+            const unsigned int comp_i = fe.system_to_component_index(i).first;
+            if (comp_i != dim)
+              continue; // only look at phase field
+
+            const unsigned int idx = local_dof_indices[i];
+            if (!dof_handler.locally_owned_dofs().is_element(idx))
+              continue;
+
+            const double old_value = old_solution(idx);
+            if (extrapolate_phase_field)
+              solution(idx) = std::max(0.0,
+                                       std::min(static_cast<double>(solution(idx)), old_value));
+            else
+              solution(idx) = old_value;
+          }
+      }
+
+  solution.compress(VectorOperation::insert);
+  constraints_hanging_nodes.distribute(solution);
+}
+
 // This function applies boundary conditions
 // to the Newton iteration steps. For all variables that
 // have Dirichlet conditions on some (or all) parts
@@ -2282,79 +3073,255 @@ FracturePhaseFieldProblem<dim>::solve ()
 }
 
 
+// Solve the displacement block only. The phase-field DoFs are
+// constrained in constraints_update, i.e., their updates are zero.
 template <int dim>
-double FracturePhaseFieldProblem<dim>::newton_active_set()
+unsigned int
+FracturePhaseFieldProblem<dim>::solve_elasticity ()
 {
-  pcout << "It.\t#A.Set\tResidual\tReduction\tLSrch\t#LinIts" << std::endl;
+  if (direct_solver)
+    return solve();
 
-  LA::MPI::BlockVector residual_relevant(partition_relevant);
+  newton_update = 0;
 
-  set_initial_bc(time);
-  constraints_hanging_nodes.distribute(solution);
+  SolverControl solver_control(200, system_pde_residual.block(0).l2_norm() * 1e-8);
 
-  assemble_nl_residual();
-  residual_relevant = system_total_residual;
+  SolverGMRES<LA::MPI::Vector> solver(solver_control);
 
-  constraints_update.set_zero(system_pde_residual);
-  double newton_residual = system_pde_residual.l2_norm();
+  solver.solve(system_pde_matrix.block(0,0), newton_update.block(0),
+               system_pde_residual.block(0), preconditioner_solid);
 
-  double old_newton_residual = newton_residual;
-  unsigned int newton_step = 1;
+  constraints_update.distribute(newton_update);
 
-  pcout << "0\t\t" << std::scientific << newton_residual << std::endl;
-  std::cout.unsetf(std::ios_base::floatfield);
+  return solver_control.last_step();
+}
 
-  active_set.clear();
-  active_set.set_size(dof_handler.n_dofs());
 
-  LA::MPI::BlockVector old_solution_relevant(partition_relevant);
-  old_solution_relevant = old_solution;
+// Elastic predictor: solve the displacement equations with the phase field
+// reset to and frozen at its old time step values, discarding any
+// extrapolation of the initial guess (Newton's method on the displacement
+// block, which is linear unless the stress is decomposed). Then check the
+// complementarity conditions of the phase field: every phase-field DoF
+// either belongs to the active set (residual pushes phi above its old value)
+// or has a vanishing residual. If the resulting residual satisfies the
+// stopping criterion of newton_active_set(), the step is accepted without
+// the coupled solve and true is returned. Otherwise, the predicted
+// displacements serve as initial guess of the coupled Newton method.
+template <int dim>
+bool
+FracturePhaseFieldProblem<dim>::elastic_predictor ()
+{
+  // If the linear solver fails, the coupled Newton method starts from
+  // the initial guess instead
+  const LA::MPI::BlockVector initial_guess(solution);
 
-  unsigned int it=0;
+  newton_iterations = 0;
+  active_set_changes = 0;
 
-  double new_newton_residual = 0.0;
-  while (true)
-    {
-      ++it;
-      pcout << it << std::flush;
+  set_initial_bc(time);
+  constraints_hanging_nodes.distribute(solution);
 
-      IndexSet active_set_old = active_set;
+  // Reset all phase-field DoFs to their old values and constrain them
+  {
+    constraints_update.clear();
 
-      {
-        // compute new active set
-        active_set.clear();
-        active_set.set_size(dof_handler.n_dofs());
-        constraints_update.clear();
-        unsigned int owned_active_set_dofs = 0;
+    LA::MPI::BlockVector old_solution_relevant(partition_relevant, mpi_com);
+    old_solution_relevant = old_solution;
 
-        LA::MPI::BlockVector solution_relevant(partition_relevant);
-        solution_relevant = solution;
+    std::vector<unsigned int> local_dof_indices(fe.dofs_per_cell);
+    typename DoFHandler<dim>::active_cell_iterator cell =
+      dof_handler.begin_active(), endc = dof_handler.end();
 
-        std::vector<unsigned int> local_dof_indices(fe.dofs_per_cell);
-        typename DoFHandler<dim>::active_cell_iterator cell =
-          dof_handler.begin_active(), endc = dof_handler.end();
+    for (; cell != endc; ++cell)
+      if (cell->is_locally_owned())
+        {
+          cell->get_dof_indices(local_dof_indices);
+          for (unsigned int i=0; i<fe.dofs_per_cell; ++i)
+            {
+              const unsigned int comp_i = fe.system_to_component_index(i).first;
+              if (comp_i != dim)
+                continue; // only look at phase field
 
-        for (; cell != endc; ++cell)
-          {
-            if (! cell->is_locally_owned())
-              continue;
+              const unsigned int idx = local_dof_indices[i];
+              if (constraints_update.is_constrained(idx)
+                  || constraints_hanging_nodes.is_constrained(idx))
+                continue;
 
-            cell->get_dof_indices(local_dof_indices);
-            for (unsigned int i=0; i<fe.dofs_per_cell; ++i)
-              {
-                const unsigned int comp_i = fe.system_to_component_index(i).first;
-                if (comp_i != dim)
-                  continue; // only look at phase field
+              constraints_update.add_line(idx);
+              constraints_update.set_inhomogeneity(idx, 0.0);
+              solution(idx) = old_solution_relevant(idx);
+            }
+        }
+    solution.compress(VectorOperation::insert);
+    constraints_hanging_nodes.distribute(solution);
 
-                const unsigned int idx = local_dof_indices[i];
+    set_newton_bc();
+    constraints_update.merge(constraints_hanging_nodes);
+    constraints_update.close();
+  }
 
-                double old_value = old_solution_relevant(idx);
-                double new_value = solution_relevant(idx);
+  pcout << "Elastic predictor:";
 
-                //already processed or a hanging node?
-                if (active_set.is_element(idx)
-                    || constraints_hanging_nodes.is_constrained(idx))
-                  continue;
+  double residual_u = 0.0;
+  unsigned int it = 0;
+  try
+    {
+      while (true)
+        {
+          assemble_nl_residual();
+          constraints_update.set_zero(system_pde_residual);
+          residual_u = system_pde_residual.l2_norm();
+
+          if (residual_u < lower_bound_newton_residuum)
+            break;
+
+          if (it >= max_no_newton_steps)
+            {
+              pcout << " no convergence" << std::endl;
+              return false;
+            }
+
+          assemble_system(false, true);
+          constraints_update.set_zero(system_pde_residual);
+          const unsigned int no_linear_iterations = solve_elasticity();
+          solution += newton_update;
+          ++it;
+
+          pcout << " " << no_linear_iterations << std::flush;
+        }
+    }
+  catch (SolverControl::NoConvergence e)
+    {
+      pcout << " linear solver did not converge" << std::endl;
+      solution = initial_guess;
+      return false;
+    }
+
+  // Complementarity conditions for the frozen phase field
+  LA::MPI::BlockVector residual_relevant(partition_relevant, mpi_com);
+  residual_relevant = system_total_residual;
+
+  active_set.clear();
+  active_set.set_size(dof_handler.n_dofs());
+  double local_violation = 0.0;
+
+  std::vector<unsigned int> local_dof_indices(fe.dofs_per_cell);
+  typename DoFHandler<dim>::active_cell_iterator cell =
+    dof_handler.begin_active(), endc = dof_handler.end();
+
+  for (; cell != endc; ++cell)
+    if (cell->is_locally_owned())
+      {
+        cell->get_dof_indices(local_dof_indices);
+        for (unsigned int i=0; i<fe.dofs_per_cell; ++i)
+          {
+            const unsigned int comp_i = fe.system_to_component_index(i).first;
+            if (comp_i != dim)
+              continue; // only look at phase field
+
+            const unsigned int idx = local_dof_indices[i];
+            if (active_set.is_element(idx)
+                || constraints_hanging_nodes.is_constrained(idx))
+              continue;
+
+            // same criterion as in newton_active_set() with zero gap
+            if (residual_relevant(idx)/diag_mass_relevant(idx) > 0)
+              active_set.add_index(idx);
+            else if (dof_handler.locally_owned_dofs().is_element(idx))
+              local_violation += residual_relevant(idx) * residual_relevant(idx);
+          }
+      }
+
+  const double residual_pf = std::sqrt(Utilities::MPI::sum(local_violation, mpi_com));
+  const double residual = std::sqrt(residual_u * residual_u + residual_pf * residual_pf);
+
+  pcout << std::scientific << "\tu: " << residual_u
+        << "\tphi: " << residual_pf << std::endl;
+  pcout.get_stream().unsetf(std::ios_base::floatfield);
+
+  return (residual < lower_bound_newton_residuum);
+}
+
+
+template <int dim>
+double FracturePhaseFieldProblem<dim>::newton_active_set()
+{
+  pcout << "It.\t#A.Set\tResidual\tReduction\tLSrch\t#LinIts" << std::endl;
+  n_residual_assemblies = 0;
+  newton_iterations = 0;
+  active_set_changes = 0;
+
+  LA::MPI::BlockVector residual_relevant(partition_relevant, mpi_com);
+
+  set_initial_bc(time);
+  constraints_hanging_nodes.distribute(solution);
+
+  assemble_nl_residual();
+  residual_relevant = system_total_residual;
+
+  constraints_update.set_zero(system_pde_residual);
+  double newton_residual = system_pde_residual.l2_norm();
+
+  double old_newton_residual = newton_residual;
+  unsigned int newton_step = 1;
+
+  pcout << "0\t\t" << std::scientific << newton_residual << std::endl;
+  pcout.get_stream().unsetf(std::ios_base::floatfield);
+
+  active_set.clear();
+  active_set.set_size(dof_handler.n_dofs());
+
+  LA::MPI::BlockVector old_solution_relevant(partition_relevant, mpi_com);
+  old_solution_relevant = old_solution;
+
+  unsigned int it=0;
+
+  double new_newton_residual = 0.0;
+  while (true)
+    {
+      ++it;
+      ++newton_iterations;
+      ++step_newton_iterations;
+      ++total_newton_iterations;
+      pcout << it << std::flush;
+
+      IndexSet active_set_old = active_set;
+
+      {
+        // compute new active set
+        active_set.clear();
+        active_set.set_size(dof_handler.n_dofs());
+        constraints_update.clear();
+        unsigned int owned_active_set_dofs = 0;
+
+        LA::MPI::BlockVector solution_relevant(partition_relevant, mpi_com);
+        solution_relevant = solution;
+
+        std::vector<unsigned int> local_dof_indices(fe.dofs_per_cell);
+        typename DoFHandler<dim>::active_cell_iterator cell =
+          dof_handler.begin_active(), endc = dof_handler.end();
+
+        for (; cell != endc; ++cell)
+          {
+            if (! cell->is_locally_owned())
+              continue;
+
+            cell->get_dof_indices(local_dof_indices);
+            for (unsigned int i=0; i<fe.dofs_per_cell; ++i)
+              {
+                const unsigned int comp_i = fe.system_to_component_index(i).first;
+                if (comp_i != dim)
+                  continue; // only look at phase field
+
+                const unsigned int idx = local_dof_indices[i];
+
+                double old_value = old_solution_relevant(idx);
+                double new_value = solution_relevant(idx);
+
+                //already processed or a hanging node?
+                if (active_set.is_element(idx)
+                    || constraints_hanging_nodes.is_constrained(idx))
+                  continue;
 
                 double c= 1e+1 * E_modulus;
                 double massm = diag_mass_relevant(idx);
@@ -2392,7 +3359,9 @@ double FracturePhaseFieldProblem<dim>::newton_active_set()
 
       int is_my_set_changed = (active_set == active_set_old) ? 0 : 1;
       int num_changed = Utilities::MPI::sum(is_my_set_changed,
-                                            MPI_COMM_WORLD);
+                                            mpi_com);
+      if (num_changed > 0)
+        ++active_set_changes;
 
       assemble_system();
       constraints_update.set_zero(system_pde_residual);
@@ -2418,26 +3387,32 @@ double FracturePhaseFieldProblem<dim>::newton_active_set()
       // line search:
       unsigned int line_search_step = 0;
 
-      for (; line_search_step < max_no_line_search_steps; ++line_search_step)
-        {
-          solution += newton_update;
+      if (line_search_mode == LineSearchMode::batched)
+        line_search_step = line_search_batched(newton_residual, false,
+                                               new_newton_residual);
+      else
+        for (; line_search_step < max_no_line_search_steps; ++line_search_step)
+          {
+            solution += newton_update;
 
-          assemble_nl_residual();
-          residual_relevant = system_total_residual;
-          constraints_update.set_zero(system_pde_residual);
-          new_newton_residual = system_pde_residual.l2_norm();
+            assemble_nl_residual();
+            constraints_update.set_zero(system_pde_residual);
+            new_newton_residual = system_pde_residual.l2_norm();
 
 
-          if (new_newton_residual < newton_residual)
-            break;
+            if (new_newton_residual < newton_residual)
+              break;
+
+            solution = saved_solution;
+            newton_update *= line_search_damping;
+          }
+      // the residual of the last trial point determines the next active set
+      residual_relevant = system_total_residual;
 
-          solution = saved_solution;
-          newton_update *= line_search_damping;
-        }
       pcout << std::scientific
             << "\t" << new_newton_residual
             << "\t" << new_newton_residual/newton_residual;
-      std::cout.unsetf(std::ios_base::floatfield);
+      pcout.get_stream().unsetf(std::ios_base::floatfield);
       pcout << "\t" << line_search_step
             << "\t" << no_linear_iterations
             << std::endl;
@@ -2452,6 +3427,7 @@ double FracturePhaseFieldProblem<dim>::newton_active_set()
           && num_changed == 0
          )
         {
+          pcout << "Residual assemblies: " << n_residual_assemblies << std::endl;
           break;
         }
 
@@ -2476,6 +3452,9 @@ FracturePhaseFieldProblem<dim>::newton_iteration (
 
 {
   pcout << "It.\tResidual\tReduction\tLSrch\t\t#LinIts" << std::endl;
+  n_residual_assemblies = 0;
+  newton_iterations = 0;
+  active_set_changes = 0;
 
   // Decision whether the system matrix should be build
   // at each Newton step
@@ -2498,14 +3477,21 @@ FracturePhaseFieldProblem<dim>::newton_iteration (
 
   pcout << "0\t" << std::scientific << newton_residuum << std::endl;
 
+  // True if system_pde_residual belongs to the current solution, i.e.,
+  // after the initial assembly and after an accepted line search step.
+  bool residual_is_current = true;
+
   while (newton_residuum > lower_bound_newton_residuum
          && newton_step < max_no_newton_steps)
     {
       old_newton_residuum = newton_residuum;
 
-      assemble_nl_residual();
-      constraints_update.set_zero(system_pde_residual);
-      newton_residuum = system_pde_residual.linfty_norm();
+      if (!residual_is_current)
+        {
+          assemble_nl_residual();
+          constraints_update.set_zero(system_pde_residual);
+          newton_residuum = system_pde_residual.linfty_norm();
+        }
 
       if (newton_residuum < lower_bound_newton_residuum)
         {
@@ -2513,6 +3499,10 @@ FracturePhaseFieldProblem<dim>::newton_iteration (
           break;
         }
 
+      ++newton_iterations;
+      ++step_newton_iterations;
+      ++total_newton_iterations;
+
       if (newton_step==1 || newton_residuum / old_newton_residuum > nonlinear_rho)
         assemble_system();
 
@@ -2520,21 +3510,29 @@ FracturePhaseFieldProblem<dim>::newton_iteration (
       no_linear_iterations = solve();
 
       line_search_step = 0;
-      for (; line_search_step < max_no_line_search_steps; ++line_search_step)
-        {
-          solution += newton_update;
+      if (line_search_mode == LineSearchMode::batched)
+        line_search_step = line_search_batched(newton_residuum, true,
+                                               new_newton_residuum);
+      else
+        for (; line_search_step < max_no_line_search_steps; ++line_search_step)
+          {
+            solution += newton_update;
 
-          assemble_nl_residual();
-          constraints_update.set_zero(system_pde_residual);
-          new_newton_residuum = system_pde_residual.linfty_norm();
+            assemble_nl_residual();
+            constraints_update.set_zero(system_pde_residual);
+            new_newton_residuum = system_pde_residual.linfty_norm();
 
-          if (new_newton_residuum < newton_residuum)
-            break;
-          else
-            solution -= newton_update;
+            if (new_newton_residuum < newton_residuum)
+              break;
+            else
+              solution -= newton_update;
+
+            newton_update *= line_search_damping;
+          }
+      // If all trial points were rejected, the solution was reset and the
+      // residual has to be recomputed in the next iteration.
+      residual_is_current = (line_search_step < max_no_line_search_steps);
 
-          newton_update *= line_search_damping;
-        }
       old_newton_residuum = newton_residuum;
       newton_residuum = new_newton_residuum;
 
@@ -2581,10 +3579,83 @@ FracturePhaseFieldProblem<dim>::newton_iteration (
   return newton_residuum/old_newton_residuum;
 }
 
+// Line search in which batches of line_search_batch_size damping
+// factors 1, d, d^2, ... (d = line_search_damping) are evaluated
+// by a single call of assemble_nl_residual_batch(). The first damping factor
+// reducing the residual below reference_residual is accepted: the solution
+// is updated and system_pde_residual and system_total_residual hold the
+// residual of the new iterate. If no trial point is accepted, the solution
+// remains unchanged and the residuals of the last trial point are kept, as
+// in the backtracking line search. Returns the index of the accepted
+// damping factor or max_no_line_search_steps.
 template <int dim>
-void
-FracturePhaseFieldProblem<dim>::project_back_phase_field ()
+unsigned int
+FracturePhaseFieldProblem<dim>::line_search_batched (
+  const double reference_residual,
+  const bool use_linfty_norm,
+  double &new_residual)
+{
+  const unsigned int batch_size = std::min(line_search_batch_size,
+                                           max_no_line_search_steps);
+  std::vector<LA::MPI::BlockVector> pde_residuals(batch_size);
+  std::vector<LA::MPI::BlockVector> total_residuals(batch_size);
+  for (unsigned int k = 0; k < batch_size; ++k)
+    {
+      pde_residuals[k].reinit(partition, mpi_com);
+      total_residuals[k].reinit(partition, mpi_com);
+    }
+
+  unsigned int line_search_step = 0;
+  double alpha = 1.0;
+  while (line_search_step < max_no_line_search_steps)
+    {
+      std::vector<double> alphas(std::min(batch_size,
+                                          max_no_line_search_steps - line_search_step));
+      for (unsigned int k = 0; k < alphas.size(); ++k)
+        {
+          alphas[k] = alpha;
+          alpha *= line_search_damping;
+        }
+
+      assemble_nl_residual_batch(alphas, pde_residuals, total_residuals);
+
+      for (unsigned int k = 0; k < alphas.size(); ++k, ++line_search_step)
+        {
+          constraints_update.set_zero(pde_residuals[k]);
+          new_residual = (use_linfty_norm
+                          ?
+                          pde_residuals[k].linfty_norm()
+                          :
+                          pde_residuals[k].l2_norm());
+
+          if (new_residual < reference_residual
+              || line_search_step+1 == max_no_line_search_steps)
+            {
+              system_pde_residual = pde_residuals[k];
+              system_total_residual = total_residuals[k];
+            }
+
+          if (new_residual < reference_residual)
+            {
+              solution.add(alphas[k], newton_update);
+              newton_update *= alphas[k];
+              return line_search_step;
+            }
+        }
+    }
+
+  return line_search_step;
+}
+
+// Maximal difference of the phase-field values of two vectors
+// over all locally owned DoFs of all processors
+template <int dim>
+double
+FracturePhaseFieldProblem<dim>::phase_field_change (
+  const LA::MPI::BlockVector &a, const LA::MPI::BlockVector &b) const
 {
+  double max_change = 0.0;
+
   typename DoFHandler<dim>::active_cell_iterator cell =
     dof_handler.begin_active(), endc = dof_handler.end();
 
@@ -2603,123 +3674,637 @@ FracturePhaseFieldProblem<dim>::project_back_phase_field ()
             if (!dof_handler.locally_owned_dofs().is_element(idx))
               continue;
 
-            solution(idx) = std::max(0.0,
-                                     std::min(static_cast<double>(solution(idx)), 1.0));
+            max_change = std::max(max_change,
+                                  std::abs(static_cast<double>(a(idx))
+                                           - static_cast<double>(b(idx))));
           }
       }
 
-  solution.compress(VectorOperation::insert);
+  return Utilities::MPI::max(max_change, mpi_com);
 }
 
+// Number of DoFs in the active set over all processors
+template <int dim>
+unsigned int
+FracturePhaseFieldProblem<dim>::active_set_size () const
+{
+  const unsigned int owned_active_set_dofs
+    = (active_set & dof_handler.locally_owned_dofs()).n_elements();
+  return Utilities::MPI::sum(owned_active_set_dofs, mpi_com);
+}
 
-
-//////////////////
+// Remember the state of the last snapshot written
 template <int dim>
 void
-FracturePhaseFieldProblem<dim>::output_results () const
+FracturePhaseFieldProblem<dim>::set_output_reference ()
 {
-  static int refinement_cycle=-1;
-  ++refinement_cycle;
-
-  LA::MPI::BlockVector relevant_solution(partition_relevant);
-  relevant_solution = solution;
-
-  SneddonExactPostProc<dim> exact_sol_sneddon(alpha_eps);
-  DataOut<dim> data_out;
-  {
-    std::vector<std::string> solution_names(dim, "dis");
-    solution_names.push_back("phi");
-    std::vector<DataComponentInterpretation::DataComponentInterpretation> data_component_interpretation(
-      dim, DataComponentInterpretation::component_is_part_of_vector);
-    data_component_interpretation.push_back(DataComponentInterpretation::component_is_scalar);
-    data_out.add_data_vector(dof_handler, relevant_solution,
-                             solution_names, data_component_interpretation);
-  }
-
-  {
-    std::vector<std::string> solution_names;
-    solution_names.push_back("displacement_x");
-    solution_names.push_back("displacement_y");
-    solution_names.push_back("phasefieldagain");
-    std::vector<DataComponentInterpretation::DataComponentInterpretation> data_component_interpretation(
-      dim+1, DataComponentInterpretation::component_is_scalar);
-    data_out.add_data_vector(dof_handler, relevant_solution,
-                             solution_names, data_component_interpretation);
-  }
-
-  if (test_case == TestCase::sneddon_2d)
-    {
-      data_out.add_data_vector(dof_handler, relevant_solution, exact_sol_sneddon);
-    }
+  output_reference_solution.reinit(partition, mpi_com);
+  output_reference_solution = solution;
+  output_reference_valid = true;
+  output_reference_crack_energy = crack_energy;
+  output_reference_active_set_size = active_set_size();
+  steps_since_output = 0;
+  output_reference_wall_time = std::chrono::steady_clock::now();
+}
 
-  Vector<float> e_mod(triangulation.n_active_cells());
-  if (test_case == TestCase::multiple_het)
+// Decide whether to write a snapshot of the current step: after
+// output_interval steps, or if the crack advanced since the last
+// snapshot and this was at least output_min_wall_time seconds ago.
+// After a change of the mesh the phase field can not be compared and
+// the change of the mesh counts as an event. The decision is the same
+// on all processors.
+template <int dim>
+bool
+FracturePhaseFieldProblem<dim>::output_due ()
+{
+  ++steps_since_output;
+  if (output_interval > 0 && steps_since_output >= output_interval)
     {
-      typename DoFHandler<dim>::active_cell_iterator cell =
-        dof_handler.begin_active(), endc = dof_handler.end();
-
-      std::vector<unsigned int> local_dof_indices(fe.dofs_per_cell);
-      unsigned int cellindex = 0;
-      for (; cell != endc; ++cell, ++cellindex)
-        if (cell->is_locally_owned())
-          {
-            e_mod(cellindex) = 1.0 + func_emodulus->value(cell->center(), 0);
-          }
-      data_out.add_data_vector(e_mod, "emodulus");
+      set_output_reference();
+      return true;
     }
 
+  // All processors decide with the largest elapsed time
+  double wall_time = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - output_reference_wall_time).count();
+  wall_time = Utilities::MPI::max(wall_time, mpi_com);
+  if (wall_time < output_min_wall_time)
+    return false;
+
+  std::string reason;
+  if (!output_reference_valid)
+    reason = "mesh change";
+  else if (output_phase_field_change > 0.0
+           && phase_field_change(solution, output_reference_solution)
+           > output_phase_field_change)
+    reason = "phase-field change";
+  else if (output_active_set_growth > 0
+           && active_set_size() >= output_reference_active_set_size
+           + output_active_set_growth)
+    reason = "active set growth";
+  else if (output_crack_energy_increase > 0.0
+           && crack_energy - output_reference_crack_energy
+           > output_crack_energy_increase * std::abs(output_reference_crack_energy))
+    reason = "crack energy increase";
+
+  if (reason.empty())
+    return false;
+
+  pcout << "Output triggered by " << reason << std::endl;
+  set_output_reference();
+  return true;
+}
 
-  Vector<float> subdomain(triangulation.n_active_cells());
-  for (unsigned int i = 0; i < subdomain.size(); ++i)
-    subdomain(i) = triangulation.locally_owned_subdomain();
-  data_out.add_data_vector(subdomain, "subdomain");
-
-  if (outer_solver == OuterSolverType::active_set)
-    data_out.add_data_vector(dof_handler, active_set,
-                             "active_set");
-
-  data_out.build_patches();
+// Cut the current time step after a failed Newton solve. Returns false
+// if the adaptive time step is at its minimum already and cannot be cut.
+template <int dim>
+bool
+FracturePhaseFieldProblem<dim>::cut_timestep ()
+{
+  if (timestep_control == TimestepControl::adaptive
+      && timestep <= min_timestep)
+    return false;
 
-  // Filename basis comes from parameter file
-  std::ostringstream filename;
+  time -= timestep;
+  if (timestep_control == TimestepControl::adaptive)
+    timestep = std::max(min_timestep, 0.5 * timestep);
+  else
+    timestep = timestep/10.0;
+  time += timestep;
 
-  pcout << "Write solution " << refinement_cycle << std::endl;
+  // old_timestep is the size of the step being computed and, once the
+  // step is accepted, of the step taken, used by the extrapolations
+  old_timestep = timestep;
 
-  filename << "output/"
-           << filename_basis
-           << Utilities::int_to_string(refinement_cycle, 5)
-           << "."
-           << Utilities::int_to_string(triangulation.locally_owned_subdomain(), 4)
-           << ".vtu";
+  pcout << "Time step cut to " << timestep << std::endl;
+  return true;
+}
 
-  std::ofstream output(filename.str().c_str());
-  data_out.write_vtu(output);
+// PI-type controller for the size of the next load increment, see
+// Gustafsson (1991). The indicator relates the effort of the last
+// step to its targets: the Newton iterations including those of rejected
+// attempts plus the iterations in which the active set changed, and the
+// maximal change of the phase field, which measures the crack advance.
+// An indicator above 1 shrinks the step, below 1 it grows. After a cut
+// the step is not allowed to grow again in the next step.
+template <int dim>
+double
+FracturePhaseFieldProblem<dim>::compute_next_timestep (
+  const double pf_change, const bool step_was_cut)
+{
+  const double k_I = 0.3;
+  const double k_P = 0.4;
 
-  if (Utilities::MPI::this_mpi_process(mpi_com) == 0)
-    {
-      std::vector<std::string> filenames;
-      for (unsigned int i = 0; i < Utilities::MPI::n_mpi_processes(mpi_com);
-           ++i)
-        filenames.push_back(
-          filename_basis + Utilities::int_to_string(refinement_cycle, 5)
-          + "." + Utilities::int_to_string(i, 4) + ".vtu");
+  double indicator = std::max(
+                       (step_newton_iterations + active_set_changes)
+                       / static_cast<double>(target_newton_iterations),
+                       pf_change / target_pf_change);
+  indicator = std::max(indicator, 1.0e-2);
 
-      std::ofstream master_output(
-        ("output/" + filename_basis + Utilities::int_to_string(refinement_cycle, 5)
-         + ".pvtu").c_str());
-      data_out.write_pvtu_record(master_output, filenames);
+  double factor = std::pow(1.0/indicator, k_I)
+                  * std::pow(old_timestep_indicator/indicator, k_P);
+  old_timestep_indicator = indicator;
 
-      std::string visit_master_filename = ("output/" + filename_basis
-                                           + Utilities::int_to_string(refinement_cycle, 5) + ".visit");
-      std::ofstream visit_master(visit_master_filename.c_str());
-      data_out.write_visit_record(visit_master, filenames);
+  factor = std::max(0.5, std::min(factor, timestep_growth_limit));
+  if (step_was_cut)
+    factor = std::min(factor, 1.0);
 
-      static std::vector<std::vector<std::string> > output_file_names_by_timestep;
-      output_file_names_by_timestep.push_back(filenames);
-      std::ofstream global_visit_master("output/solution.visit");
-      data_out.write_visit_record(global_visit_master,
-                                  output_file_names_by_timestep);
-    }
+  return std::max(min_timestep, std::min(max_timestep, factor * timestep));
+}
+
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::project_back_phase_field ()
+{
+  typename DoFHandler<dim>::active_cell_iterator cell =
+    dof_handler.begin_active(), endc = dof_handler.end();
+
+  std::vector<unsigned int> local_dof_indices(fe.dofs_per_cell);
+  for (; cell != endc; ++cell)
+    if (cell->is_locally_owned())
+      {
+        cell->get_dof_indices(local_dof_indices);
+        for (unsigned int i=0; i<fe.dofs_per_cell; ++i)
+          {
+            const unsigned int comp_i = fe.system_to_component_index(i).first;
+            if (comp_i != dim)
+              continue; // only look at phase field
+
+            const unsigned int idx = local_dof_indices[i];
+            if (!dof_handler.locally_owned_dofs().is_element(idx))
+              continue;
+
+            solution(idx) = std::max(0.0,
+                                     std::min(static_cast<double>(solution(idx)), 1.0));
+          }
+      }
+
+  solution.compress(VectorOperation::insert);
+}
+
+
+
+//////////////////
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::output_results ()
+{
+  ++output_cycle;
+  const int refinement_cycle = output_cycle;
+
+  LA::MPI::BlockVector relevant_solution(partition_relevant, mpi_com);
+  relevant_solution = solution;
+
+  // Cells to write: all, or the crack region (phase field below the
+  // output value) and a coarse background
+  std::vector<bool> selected_cells(triangulation.n_active_cells(), true);
+  if (output_crack_region_only)
+    {
+      std::vector<unsigned int> local_dof_indices(fe.dofs_per_cell);
+      typename DoFHandler<dim>::active_cell_iterator cell =
+        dof_handler.begin_active(), endc = dof_handler.end();
+      for (; cell != endc; ++cell)
+        if (cell->is_locally_owned()
+            && cell->level() > static_cast<int>(output_background_level))
+          {
+            selected_cells[cell->active_cell_index()] = false;
+            cell->get_dof_indices(local_dof_indices);
+            for (unsigned int i=0; i<fe.dofs_per_cell; ++i)
+              if (fe.system_to_component_index(i).first == dim
+                  && relevant_solution(local_dof_indices[i]) < value_phase_field_for_output)
+                {
+                  selected_cells[cell->active_cell_index()] = true;
+                  break;
+                }
+          }
+    }
+
+  SneddonExactPostProc<dim> exact_sol_sneddon(alpha_eps);
+  PhaseFieldPostProc<dim> phase_field_only;
+  SelectedCellsDataOut<dim> data_out(selected_cells);
+  if (output_profile == OutputProfile::minimal)
+    data_out.add_data_vector(dof_handler, relevant_solution, phase_field_only);
+  else
+    {
+      std::vector<std::string> solution_names(dim, "dis");
+      solution_names.push_back("phi");
+      std::vector<DataComponentInterpretation::DataComponentInterpretation> data_component_interpretation(
+        dim, DataComponentInterpretation::component_is_part_of_vector);
+      data_component_interpretation.push_back(DataComponentInterpretation::component_is_scalar);
+      data_out.add_data_vector(dof_handler, relevant_solution,
+                               solution_names, data_component_interpretation);
+    }
+
+  if (output_profile == OutputProfile::full)
+    {
+      std::vector<std::string> solution_names;
+      solution_names.push_back("displacement_x");
+      solution_names.push_back("displacement_y");
+      solution_names.push_back("phasefieldagain");
+      std::vector<DataComponentInterpretation::DataComponentInterpretation> data_component_interpretation(
+        dim+1, DataComponentInterpretation::component_is_scalar);
+      data_out.add_data_vector(dof_handler, relevant_solution,
+                               solution_names, data_component_interpretation);
+    }
+
+  if (test_case == TestCase::sneddon_2d && output_profile != OutputProfile::minimal)
+    {
+      data_out.add_data_vector(dof_handler, relevant_solution, exact_sol_sneddon);
+    }
+
+  Vector<float> e_mod(triangulation.n_active_cells());
+  if (test_case == TestCase::multiple_het && output_profile != OutputProfile::minimal)
+    {
+      typename DoFHandler<dim>::active_cell_iterator cell =
+        dof_handler.begin_active(), endc = dof_handler.end();
+
+      std::vector<unsigned int> local_dof_indices(fe.dofs_per_cell);
+      unsigned int cellindex = 0;
+      for (; cell != endc; ++cell, ++cellindex)
+        if (cell->is_locally_owned())
+          {
+            e_mod(cellindex) = 1.0 + func_emodulus->value(cell->center(), 0);
+          }
+      data_out.add_data_vector(e_mod, "emodulus");
+    }
+
+
+  Vector<float> subdomain(triangulation.n_active_cells());
+  if (output_profile == OutputProfile::full)
+    {
+      for (unsigned int i = 0; i < subdomain.size(); ++i)
+        subdomain(i) = triangulation.locally_owned_subdomain();
+      data_out.add_data_vector(subdomain, "subdomain");
+    }
+
+  if (outer_solver == OuterSolverType::active_set
+      && output_profile != OutputProfile::minimal)
+    data_out.add_data_vector(dof_handler, active_set,
+                             "active_set");
+
+  data_out.build_patches();
+  const DataOutBase::VtkFlags vtk_flags(time, refinement_cycle, true,
+                                        output_compression);
+  data_out.set_flags(vtk_flags);
+
+  // Filename basis comes from parameter file
+  pcout << "Write solution " << refinement_cycle << std::endl;
+
+  const unsigned int my_rank = Utilities::MPI::this_mpi_process(mpi_com);
+  const unsigned int n_ranks = Utilities::MPI::n_mpi_processes(mpi_com);
+  if (output_mode == OutputMode::vtu_in_parallel)
+    {
+      // One .vtu file per group of processors, written collectively
+      // with MPI-IO, and a .pvtu record if there is more than one group
+      const unsigned int n_groups = std::max(1u, std::min(output_n_groups, n_ranks));
+      const unsigned int group = static_cast<unsigned int>(
+                                   static_cast<unsigned long long>(my_rank) * n_groups / n_ranks);
+      if (output_group_com == MPI_COMM_NULL)
+        MPI_Comm_split(mpi_com, group, my_rank, &output_group_com);
+
+      std::vector<std::string> filenames;
+      for (unsigned int i = 0; i < n_groups; ++i)
+        filenames.push_back(
+          filename_basis + Utilities::int_to_string(refinement_cycle, 5)
+          + (n_groups > 1 ? "." + Utilities::int_to_string(i, 4) : std::string())
+          + ".vtu");
+
+      const std::chrono::steady_clock::time_point start
+        = std::chrono::steady_clock::now();
+      data_out.write_vtu_in_parallel(output_directory + "/" + filenames[group], output_group_com);
+      const double seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start).count();
+
+      if (my_rank == 0)
+        {
+          std::ifstream written((output_directory + "/" + filenames[group]).c_str(),
+                                std::ios::binary | std::ios::ate);
+          report_output_rate(refinement_cycle,
+                             std::make_pair(static_cast<double>(written.tellg()) / 1.0e6,
+                                            seconds));
+
+          if (n_groups > 1)
+            {
+              std::ofstream master_output(
+                (output_directory + "/" + filename_basis + Utilities::int_to_string(refinement_cycle, 5)
+                 + ".pvtu").c_str());
+              data_out.write_pvtu_record(master_output, filenames);
+            }
+
+          output_file_names_by_timestep.push_back(filenames);
+          std::ofstream global_visit_master((output_directory + "/" + filename_basis + "solution.visit").c_str());
+          data_out.write_visit_record(global_visit_master,
+                                      output_file_names_by_timestep);
+        }
+      return;
+    }
+  else if (output_mode == OutputMode::hdf5)
+    {
+#ifdef DEAL_II_WITH_HDF5
+      // One .h5 file per step written collectively, and an XDMF file
+      // with the time series of all steps
+      DataOutBase::DataOutFilter data_filter(DataOutBase::DataOutFilterFlags(true, true));
+      data_out.write_filtered_data(data_filter);
+
+      const std::string h5_filename = filename_basis
+                                      + Utilities::int_to_string(refinement_cycle, 5) + ".h5";
+      data_out.write_hdf5_parallel(data_filter, output_directory + "/" + h5_filename, mpi_com);
+
+      xdmf_entries.push_back(data_out.create_xdmf_entry(data_filter, h5_filename,
+                                                        time, mpi_com));
+      data_out.write_xdmf_file(xdmf_entries, output_directory + "/" + filename_basis + "solution.xdmf",
+                               mpi_com);
+#else
+      AssertThrow(false, ExcMessage("HDF5 output requires deal.II with HDF5"));
+#endif
+      return;
+    }
+
+  if (async_output)
+    {
+      // The patches are built here, as the mesh may change in the next
+      // time step. Writing them is done in the background. If the queue
+      // is full, wait for the oldest output to finish.
+      std::shared_ptr<OutputBuffer<dim> > buffer(new OutputBuffer<dim>());
+      data_out.copy_patches(*buffer);
+      buffer->set_flags(vtk_flags);
+
+      while (output_threads.size() >= output_queue_length)
+        {
+          const std::pair<unsigned int, std::pair<double, double> > written
+            = output_threads.front().get();
+          output_threads.pop_front();
+          report_output_rate(written.first, written.second);
+        }
+
+      const std::string directory = output_directory;
+      const std::string basis = filename_basis;
+      const unsigned int cycle = refinement_cycle;
+      output_threads.push_back(std::async(std::launch::async,
+                                          [buffer, directory, basis, cycle, my_rank, n_ranks]()
+      {
+        return std::make_pair(cycle,
+                              write_output_files<dim>(*buffer, directory, basis,
+                                                      cycle, my_rank, n_ranks));
+      }));
+    }
+  else
+    report_output_rate(refinement_cycle,
+                       write_output_files<dim>(data_out, output_directory, filename_basis,
+                                               refinement_cycle, my_rank, n_ranks));
+
+  if (my_rank == 0)
+    {
+      std::vector<std::string> filenames;
+      for (unsigned int i = 0; i < n_ranks; ++i)
+        filenames.push_back(
+          filename_basis + Utilities::int_to_string(refinement_cycle, 5)
+          + "." + Utilities::int_to_string(i, 4) + ".vtu");
+
+      output_file_names_by_timestep.push_back(filenames);
+      std::ofstream global_visit_master((output_directory + "/" + filename_basis + "solution.visit").c_str());
+      data_out.write_visit_record(global_visit_master,
+                                  output_file_names_by_timestep);
+    }
+}
+
+
+// Wait until all output in the background is written
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::flush_output ()
+{
+  while (!output_threads.empty())
+    {
+      const std::pair<unsigned int, std::pair<double, double> > written
+        = output_threads.front().get();
+      output_threads.pop_front();
+      report_output_rate(written.first, written.second);
+    }
+}
+
+// Save the mesh with the solutions of the current and the last two
+// time steps attached, and the state of the time stepping in a .state
+// file. The .state file is written last and marks the checkpoint as
+// complete. Triangulation::save() is collective and works on the
+// current mesh, so the checkpoint is written before the next step.
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::save_checkpoint ()
+{
+  const std::string name = output_directory + "/" + filename_basis + "checkpoint-"
+                           + Utilities::int_to_string(timestep_number, 5);
+  pcout << "Write checkpoint " << name << std::endl;
+
+  // The solutions are read at all DoFs of the locally owned cells
+  LA::MPI::BlockVector relevant_solution(partition_relevant, mpi_com);
+  LA::MPI::BlockVector relevant_old_solution(partition_relevant, mpi_com);
+  LA::MPI::BlockVector relevant_old_old_solution(partition_relevant, mpi_com);
+  relevant_solution = solution;
+  relevant_old_solution = old_solution;
+  relevant_old_old_solution = old_old_solution;
+
+  std::vector<const LA::MPI::BlockVector *> x(3);
+  x[0] = &relevant_solution;
+  x[1] = &relevant_old_solution;
+  x[2] = &relevant_old_old_solution;
+
+  parallel::distributed::SolutionTransfer<dim, LA::MPI::BlockVector> solution_transfer(
+    dof_handler);
+  solution_transfer.prepare_for_serialization(x);
+  triangulation.save(name);
+
+  if (Utilities::MPI::this_mpi_process(mpi_com) == 0)
+    {
+      // The names of the output files written so far, to continue the
+      // .visit and .xdmf time series after a restart
+      {
+        std::ofstream output_file((name + ".output").c_str());
+        boost::archive::text_oarchive archive(output_file);
+        archive << output_file_names_by_timestep << xdmf_entries;
+      }
+
+      std::ofstream f((name + ".state").c_str());
+      f << std::setprecision(17)
+        << time << " " << timestep << " " << timestep_number << " "
+        << old_timestep << " " << old_old_timestep << " "
+        << output_cycle << " " << n_refinement_cycles << " "
+        << total_newton_iterations << " " << rejected_newton_iterations << " "
+        << n_redone_steps << " " << old_timestep_indicator << std::endl;
+      f.close();
+
+      checkpoint_names.push_back(name);
+      while (checkpoint_names.size() > n_checkpoints_kept)
+        {
+          const std::string &old_name = checkpoint_names.front();
+          std::remove((old_name + ".state").c_str());
+          std::remove((old_name + ".output").c_str());
+          std::remove(old_name.c_str());
+          std::remove((old_name + ".info").c_str());
+          std::remove((old_name + "_fixed.data").c_str());
+          std::remove((old_name + "_variable.data").c_str());
+          checkpoint_names.pop_front();
+        }
+    }
+}
+
+// Continue from a checkpoint written by save_checkpoint(). The
+// triangulation only contains the coarse mesh at this point. The mesh
+// is partitioned for the present number of processors.
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::load_checkpoint (const std::string &name)
+{
+  pcout << "Restart from checkpoint " << name << std::endl;
+
+  std::ifstream f((name + ".state").c_str());
+  AssertThrow (f, ExcMessage (std::string("Can't read from file <") +
+                              name + ".state>, the checkpoint is not complete!"));
+  f >> time >> timestep >> timestep_number
+    >> old_timestep >> old_old_timestep
+    >> output_cycle >> n_refinement_cycles
+    >> total_newton_iterations >> rejected_newton_iterations
+    >> n_redone_steps >> old_timestep_indicator;
+  AssertThrow (f, ExcMessage ("Invalid checkpoint state file."));
+
+  {
+    std::ifstream output_file((name + ".output").c_str());
+    AssertThrow (output_file, ExcMessage (std::string("Can't read from file <") +
+                                          name + ".output>!"));
+    boost::archive::text_iarchive archive(output_file);
+    archive >> output_file_names_by_timestep >> xdmf_entries;
+  }
+
+  triangulation.load(name);
+  setup_system();
+
+  LA::MPI::BlockVector tmp_v(partition, mpi_com);
+  LA::MPI::BlockVector tmp_vv(partition, mpi_com);
+  std::vector<LA::MPI::BlockVector *> tmp(3);
+  tmp[0] = &solution;
+  tmp[1] = &tmp_v;
+  tmp[2] = &tmp_vv;
+
+  parallel::distributed::SolutionTransfer<dim, LA::MPI::BlockVector> solution_transfer(
+    dof_handler);
+  solution_transfer.deserialize(tmp);
+  old_solution = tmp_v;
+  old_old_solution = tmp_vv;
+
+  determine_mesh_dependent_parameters();
+}
+
+// The parameters the pre-refined mesh and the initial solution depend
+// on, and the coarse mesh
+template <int dim>
+std::string
+FracturePhaseFieldProblem<dim>::mesh_cache_key (const std::string &grid_name)
+{
+  std::ostringstream key;
+
+  prm.enter_subsection("Global parameters");
+  const char *global_entries[] =
+  {
+    "test case", "Global pre-refinement steps", "Local pre-refinement steps",
+    "Adaptive refinement cycles", "ref strategy", "value phase field for refinement",
+    "Refine to target level", "Predictive refinement", "Predictive refinement band width",
+    "Coarsening", "Coarsening distance", "value phase field for coarsening",
+    "Coarsening Kelly fraction"
+  };
+  for (unsigned int i = 0; i < sizeof(global_entries) / sizeof(*global_entries); ++i)
+    key << global_entries[i] << " = " << prm.get(global_entries[i]) << "\n";
+  prm.leave_subsection();
+
+  prm.enter_subsection("Problem dependent parameters");
+  key << "K reg = " << prm.get("K reg") << "\n"
+      << "Eps reg = " << prm.get("Eps reg") << "\n";
+  prm.leave_subsection();
+
+  std::ifstream grid_file(grid_name.c_str());
+  key << grid_name << "\n" << grid_file.rdbuf();
+
+  return key.str();
+}
+
+// Store the pre-refined mesh with the initial solution in the cache
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::save_mesh_cache ()
+{
+  // Runs of an ensemble may miss the same entry at the same time. Each
+  // writes its files under its own tag (rank in MPI_COMM_WORLD and
+  // time of its first processor) and then replaces the .key file with
+  // rename(), so a key always names a complete set of files. Nothing
+  // is written if another run completed the entry meanwhile.
+  const bool first_rank = (Utilities::MPI::this_mpi_process(mpi_com) == 0);
+  const std::string key_name = mesh_cache_name + ".key";
+  unsigned long long entry[2] = {0, 0};
+  if (first_rank)
+    {
+      std::ifstream key_file(key_name.c_str());
+      entry[0] = key_file ? 1 : 0;
+      entry[1] = (static_cast<unsigned long long>(
+                    Utilities::MPI::this_mpi_process(MPI_COMM_WORLD)) << 48)
+                 ^ static_cast<unsigned long long>(
+                   std::chrono::system_clock::now().time_since_epoch().count());
+    }
+  MPI_Bcast(entry, 2, MPI_UNSIGNED_LONG_LONG, 0, mpi_com);
+  if (entry[0] == 1)
+    return;
+  mesh_cache_tag = entry[1];
+
+  std::ostringstream tag;
+  tag << std::hex << mesh_cache_tag;
+  pcout << "Write mesh cache " << mesh_cache_name << "-" << tag.str() << std::endl;
+
+  LA::MPI::BlockVector relevant_solution(partition_relevant, mpi_com);
+  relevant_solution = solution;
+
+  parallel::distributed::SolutionTransfer<dim, LA::MPI::BlockVector> solution_transfer(
+    dof_handler);
+  solution_transfer.prepare_for_serialization(relevant_solution);
+  triangulation.save(mesh_cache_name + "-" + tag.str());
+
+  if (first_rank)
+    {
+      const std::string tmp_key_name = key_name + "-" + tag.str();
+      {
+        std::ofstream key_file(tmp_key_name.c_str());
+        key_file << tag.str() << "\n" << mesh_cache_parameters;
+      }
+      std::rename(tmp_key_name.c_str(), key_name.c_str());
+    }
+}
+
+// Start from the pre-refined mesh and the initial solution in the cache
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::load_mesh_cache ()
+{
+  std::ostringstream tag;
+  tag << std::hex << mesh_cache_tag;
+  pcout << "Read mesh cache " << mesh_cache_name << "-" << tag.str() << std::endl;
+
+  triangulation.load(mesh_cache_name + "-" + tag.str());
+  setup_system();
+
+  parallel::distributed::SolutionTransfer<dim, LA::MPI::BlockVector> solution_transfer(
+    dof_handler);
+  solution_transfer.deserialize(solution);
+
+  determine_mesh_dependent_parameters();
+}
+
+// Print size and write rate of the .vtu file of the first processor
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::report_output_rate (
+  const unsigned int refinement_cycle, const std::pair<double, double> &size_and_time) const
+{
+  pcout << "Solution " << refinement_cycle << " written: "
+        << size_and_time.first << " MB in " << size_and_time.second << " s ("
+        << size_and_time.first / std::max(size_and_time.second, 1.0e-9)
+        << " MB/s)" << std::endl;
 }
 
 // With help of this function, we extract
@@ -2761,6 +4346,82 @@ double bucket_to_value(unsigned int idx, unsigned int n_buckets)
   return x1 + idx*(x2-x1)/n_buckets;
 }
 
+// 64 bit FNV-1a hash of a string, the same on all platforms
+unsigned long long fnv1a_hash(const std::string &text)
+{
+  unsigned long long hash = 14695981039346656037ULL;
+  for (unsigned int i = 0; i < text.size(); ++i)
+    {
+      hash ^= static_cast<unsigned char>(text[i]);
+      hash *= 1099511628211ULL;
+    }
+  return hash;
+}
+
+// Root of the tree of i in a union-find forest, with path halving
+unsigned int find_root(std::vector<unsigned int> &parent, unsigned int i)
+{
+  while (parent[i] != i)
+    {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+  return i;
+}
+
+// Clip the segment p + t (q-p), t in [0,1], to the (convex) cell
+// (Cyrus-Beck). Returns false if the segment misses the cell, otherwise
+// the parameter interval inside the cell is given by [t0, t1].
+// on_face is set if the segment runs along one of the faces of the cell.
+template <int dim>
+bool clip_segment_to_cell(
+  const typename DoFHandler<dim>::active_cell_iterator &cell,
+  const Point<dim> &p, const Point<dim> &q,
+  double &t0, double &t1, bool &on_face)
+{
+  Assert(dim==2, ExcNotImplemented());
+
+  // vertices in counter clockwise order
+  const unsigned int order[4] = {0, 1, 3, 2};
+  const Tensor<1,dim> d = q - p;
+  const double tol = 1.0e-10 * cell->diameter();
+
+  t0 = 0.0;
+  t1 = 1.0;
+  on_face = false;
+  for (unsigned int e = 0; e < 4; ++e)
+    {
+      const Point<dim> a = cell->vertex(order[e]);
+      const Point<dim> b = cell->vertex(order[(e+1)%4]);
+
+      // inward normal of the edge
+      Tensor<1,dim> n;
+      n[0] = -(b[1]-a[1]);
+      n[1] = b[0]-a[0];
+      const double length = n.norm();
+      n /= length;
+
+      const double distance = n * (p - a);
+      const double rate = n * d;
+      if (std::abs(rate) < 1.0e-12 * d.norm())
+        {
+          if (distance < -tol)
+            return false;
+          if (distance < tol)
+            on_face = true;
+          continue;
+        }
+
+      const double t = -distance / rate;
+      if (rate > 0)
+        t0 = std::max(t0, t);
+      else
+        t1 = std::min(t1, t);
+    }
+
+  return (t1 - t0) * d.norm() > tol;
+}
+
 template <int dim>
 void
 FracturePhaseFieldProblem<dim>::compute_cod_array ()
@@ -2774,268 +4435,1268 @@ FracturePhaseFieldProblem<dim>::compute_cod_array ()
   std::vector<double> exact(n_buckets);
   for (unsigned int i=0; i<n_buckets; ++i)
     {
-      double x = bucket_to_value(i, n_buckets);
-      exact[i] = 3.84e-4*std::sqrt(std::max(0.0,1.0-(x-2.0)*(x-2.0)/0.04));
+      double x = bucket_to_value(i, n_buckets);
+      exact[i] = 3.84e-4*std::sqrt(std::max(0.0,1.0-(x-2.0)*(x-2.0)/0.04));
+    }
+
+  LA::MPI::BlockVector rel_solution(partition_relevant, mpi_com);
+  rel_solution = solution;
+
+  const double width = bucket_to_value(1, n_buckets) - bucket_to_value(0, n_buckets);
+  // bucket i contains the points closest to bucket_to_value(i)
+  const double lower_end = bucket_to_value(0, n_buckets) - 0.5 * width;
+  const double upper_end = bucket_to_value(n_buckets-1, n_buckets) + 0.5 * width;
+
+  // Cells are culled by their bounding box against the bucket range.
+  // Cells inside a single bucket are integrated with a Gauss rule.
+  // Axis parallel rectangles that intersect several buckets are sliced
+  // exactly at the bucket boundaries and each slice gets its own Gauss
+  // rule. Other cells use 100x100 evenly distributed points in the
+  // interior of the cell, avoiding points on the faces, as they would
+  // be counted more than once.
+  const QGauss<1> gauss_1d(degree+2);
+  const QGauss<dim> gauss(degree+2);
+  const QIterated<dim> iterated (QMidpoint<1>(), 100 );
+
+  FEValues<dim> fe_values_gauss(fe, gauss,
+                                update_values | update_quadrature_points | update_JxW_values
+                                | update_gradients);
+  FEValues<dim> fe_values_iterated(fe, iterated,
+                                   update_values | update_quadrature_points | update_JxW_values
+                                   | update_gradients);
+
+  std::vector<Vector<double> > solution_values;
+  std::vector<std::vector<Tensor<1, dim> > > solution_grads;
+
+  typename DoFHandler<dim>::active_cell_iterator cell =
+    dof_handler.begin_active(), endc = dof_handler.end();
+
+  for (; cell != endc; ++cell)
+    if (cell->is_locally_owned())
+      {
+        double x_min = cell->vertex(0)[0], x_max = cell->vertex(0)[0];
+        for (unsigned int v = 1; v < GeometryInfo<dim>::vertices_per_cell; ++v)
+          {
+            x_min = std::min(x_min, cell->vertex(v)[0]);
+            x_max = std::max(x_max, cell->vertex(v)[0]);
+          }
+        if (x_max <= lower_end || x_min >= upper_end)
+          continue;
+
+        const int first_bucket = value_to_bucket(x_min, n_buckets);
+        const int last_bucket = value_to_bucket(x_max, n_buckets);
+
+        // vertex 1 is to the right of vertex 0, vertex 2 above it
+        const double tol = 1.0e-12 * cell->diameter();
+        const bool rectangle = cell->vertex(0)[0] < cell->vertex(1)[0]
+                               && std::abs(cell->vertex(0)[1] - cell->vertex(1)[1]) < tol
+                               && std::abs(cell->vertex(0)[0] - cell->vertex(2)[0]) < tol
+                               && std::abs(cell->vertex(2)[1] - cell->vertex(3)[1]) < tol
+                               && std::abs(cell->vertex(1)[0] - cell->vertex(3)[0]) < tol;
+
+        // one Gauss rule per bucket on the slices of the cell
+        std::vector<std::pair<unsigned int, FEValues<dim> *> > slices;
+        std::vector<std::shared_ptr<FEValues<dim> > > slice_fe_values;
+        if (first_bucket == last_bucket || rectangle)
+          {
+            for (int b = std::max(first_bucket, 0);
+                 b <= std::min(last_bucket, static_cast<int>(n_buckets)-1); ++b)
+              {
+                if (first_bucket == last_bucket)
+                  {
+                    fe_values_gauss.reinit(cell);
+                    slices.push_back(std::make_pair(static_cast<unsigned int>(b), &fe_values_gauss));
+                    continue;
+                  }
+
+                const double a = (std::max(x_min, bucket_to_value(b, n_buckets) - 0.5*width) - x_min) / (x_max - x_min);
+                const double c = (std::min(x_max, bucket_to_value(b, n_buckets) + 0.5*width) - x_min) / (x_max - x_min);
+                if (c <= a)
+                  continue;
+
+                std::vector<Point<dim> > points;
+                std::vector<double> weights;
+                for (unsigned int i = 0; i < gauss_1d.size(); ++i)
+                  for (unsigned int j = 0; j < gauss_1d.size(); ++j)
+                    {
+                      points.push_back(Point<dim>(a + (c-a) * gauss_1d.point(i)[0],
+                                                  gauss_1d.point(j)[0]));
+                      weights.push_back((c-a) * gauss_1d.weight(i) * gauss_1d.weight(j));
+                    }
+                slice_fe_values.push_back(std::make_shared<FEValues<dim> >(
+                                            fe, Quadrature<dim>(points, weights),
+                                            update_values | update_quadrature_points | update_JxW_values
+                                            | update_gradients));
+                slice_fe_values.back()->reinit(cell);
+                slices.push_back(std::make_pair(static_cast<unsigned int>(b),
+                                                slice_fe_values.back().get()));
+              }
+          }
+        else
+          {
+            fe_values_iterated.reinit(cell);
+            slices.push_back(std::make_pair(numbers::invalid_unsigned_int, &fe_values_iterated));
+          }
+
+        for (unsigned int k = 0; k < slices.size(); ++k)
+          {
+            const FEValues<dim> &fe_values = *slices[k].second;
+            const unsigned int n_q_points = fe_values.n_quadrature_points;
+            solution_values.resize(n_q_points, Vector<double>(dim+1));
+            solution_grads.resize(n_q_points, std::vector<Tensor<1, dim> >(dim+1));
+
+            fe_values.get_function_values(rel_solution,
+                                          solution_values);
+            fe_values.get_function_gradients(
+              rel_solution, solution_grads);
+
+            for (unsigned int q = 0; q < n_q_points; ++q)
+              {
+                unsigned int idx = slices[k].first;
+                if (idx == numbers::invalid_unsigned_int)
+                  {
+                    const int idx_ = value_to_bucket(fe_values.quadrature_point(q)[0], n_buckets);
+                    if (idx_<0 || idx_>=static_cast<int>(n_buckets))
+                      continue;
+                    idx = static_cast<unsigned int>(idx_);
+                  }
+
+                const Tensor<1, dim> u = Tensors::get_u<dim>(
+                                           q, solution_values);
+
+                const Tensor<1, dim> grad_pf =
+                  Tensors::get_grad_pf<dim>(q,
+                                            solution_grads);
+
+                double cod_value =
+                  // Motivated by Bourdin et al. (2012); SPE Paper
+                  u * grad_pf;
+
+                values[idx] += cod_value * fe_values.JxW(q);
+                volume[idx] += fe_values.JxW(q);
+              }
+          }
+      }
+
+  std::vector<double> values_all(n_buckets);
+  std::vector<double> volume_all(n_buckets);
+  Utilities::MPI::sum(values, mpi_com, values_all);
+  Utilities::MPI::sum(volume, mpi_com, volume_all);
+  for (unsigned int i=0; i<n_buckets; ++i)
+    values[i] = values_all[i] / width / 2.0;
+
+  double middle_value = compute_cod(2.0);
+
+  if (Utilities::MPI::this_mpi_process(mpi_com) == 0)
+    {
+      ++n_cod_array_files;
+      std::ostringstream filename;
+      filename << output_directory << "/" << filename_basis
+               << "cod-" << Utilities::int_to_string(n_cod_array_files, 2) << ".txt";
+      pcout << "writing " << filename.str() << std::endl;
+      std::ofstream f(filename.str().c_str());
+
+      double error = 0.0;
+      for (unsigned int i=0; i<n_buckets; ++i)
+        {
+          error += std::pow(values[i]-exact[i], 2.0);
+          f << bucket_to_value(i, n_buckets) << " " << values[i] << " " << exact[i] << std::endl;
+        }
+      error = std::sqrt(error);
+      double err_middle = std::abs(middle_value-3.84e-4);
+      pcout << "ERROR: " << error
+            << " alpha_eps: " << alpha_eps
+            << " k: " << constant_k
+            << " hmin: " << min_cell_diameter
+            << " errmiddle: " << err_middle
+            << " dofs: " << dof_handler.n_dofs()
+            << std::endl;
+
+    }
+}
+
+template <int dim>
+double
+FracturePhaseFieldProblem<dim>::compute_cod (
+  const double eval_line)
+{
+  std::vector<std::vector<Point<dim> > > lines(1, std::vector<Point<dim> >(2));
+  typename DoFHandler<dim>::cell_iterator cell = dof_handler.begin(0);
+  double y_min = cell->vertex(0)[1], y_max = cell->vertex(0)[1];
+  for (; cell != dof_handler.end(0); ++cell)
+    for (unsigned int v = 0; v < GeometryInfo<dim>::vertices_per_cell; ++v)
+      {
+        y_min = std::min(y_min, cell->vertex(v)[1]);
+        y_max = std::max(y_max, cell->vertex(v)[1]);
+      }
+  lines[0][0] = Point<dim>(eval_line, y_min);
+  lines[0][1] = Point<dim>(eval_line, y_max);
+
+  const double cod_value = compute_cod_lines(lines)[0];
+
+  pcout << eval_line << "  " << cod_value << std::endl;
+
+  return cod_value;
+}
+
+
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::build_cell_buckets ()
+{
+  Assert(dim==2, ExcNotImplemented());
+
+  cell_buckets.clear();
+
+  // about one cell per bucket on a uniform mesh
+  Point<dim> lower, upper;
+  unsigned int n_cells = 0;
+  typename DoFHandler<dim>::active_cell_iterator cell =
+    dof_handler.begin_active(), endc = dof_handler.end();
+  for (; cell != endc; ++cell)
+    if (cell->is_locally_owned())
+      {
+        if (n_cells == 0)
+          lower = upper = cell->vertex(0);
+        for (unsigned int v = 0; v < GeometryInfo<dim>::vertices_per_cell; ++v)
+          for (unsigned int d = 0; d < dim; ++d)
+            {
+              lower[d] = std::min(lower[d], cell->vertex(v)[d]);
+              upper[d] = std::max(upper[d], cell->vertex(v)[d]);
+            }
+        ++n_cells;
+      }
+  cell_buckets_valid = true;
+  if (n_cells == 0)
+    return;
+  cell_bucket_size = std::max(upper[0]-lower[0], upper[1]-lower[1])
+                     / std::ceil(std::sqrt(static_cast<double>(n_cells)));
+
+  for (cell = dof_handler.begin_active(); cell != endc; ++cell)
+    if (cell->is_locally_owned())
+      {
+        Point<dim> cell_lower = cell->vertex(0), cell_upper = cell->vertex(0);
+        for (unsigned int v = 1; v < GeometryInfo<dim>::vertices_per_cell; ++v)
+          for (unsigned int d = 0; d < dim; ++d)
+            {
+              cell_lower[d] = std::min(cell_lower[d], cell->vertex(v)[d]);
+              cell_upper[d] = std::max(cell_upper[d], cell->vertex(v)[d]);
+            }
+        for (int i = static_cast<int>(std::floor(cell_lower[0]/cell_bucket_size));
+             i <= static_cast<int>(std::floor(cell_upper[0]/cell_bucket_size)); ++i)
+          for (int j = static_cast<int>(std::floor(cell_lower[1]/cell_bucket_size));
+               j <= static_cast<int>(std::floor(cell_upper[1]/cell_bucket_size)); ++j)
+            cell_buckets[std::make_pair(i,j)].push_back(cell);
+      }
+}
+
+
+// Crack opening displacement along several lines (or polylines) at
+// once: COD = 1/2 \int u \cdot \nabla \varphi ds along each line,
+// motivated by Bourdin et al. (2012); SPE Paper.
+// Only the cells intersected by a line are visited. They are found with
+// the bucket index of the locally owned cells, on each cell the line
+// is integrated with a Gauss rule on the clipped segment. Segments
+// running along a face are shared by both adjacent cells and get half
+// the weight on each. The quadrature points differ from cell to cell,
+// so the shape functions are evaluated directly at their unit points
+// instead of setting up an FEValues object for each cell, as for the
+// phase-field raster. All values are summed over the processors with
+// a single reduction.
+template <int dim>
+std::vector<double>
+FracturePhaseFieldProblem<dim>::compute_cod_lines (
+  const std::vector<std::vector<Point<dim> > > &polylines)
+{
+  if (!cell_buckets_valid)
+    build_cell_buckets();
+
+  LA::MPI::BlockVector rel_solution(partition_relevant, mpi_com);
+  rel_solution = solution;
+
+  const QGauss<1> line_quadrature(degree+2);
+  const unsigned int n_q_points = line_quadrature.size();
+
+  Vector<double> cell_dof_values(fe.dofs_per_cell);
+  std::vector<double> local_values(polylines.size(), 0.0);
+
+  for (unsigned int l = 0; l < polylines.size(); ++l)
+    for (unsigned int s = 0; s + 1 < polylines[l].size(); ++s)
+      {
+        const Point<dim> &p = polylines[l][s];
+        const Point<dim> &q = polylines[l][s+1];
+        const double length = p.distance(q);
+        if (length == 0.0 || cell_buckets.empty())
+          continue;
+
+        // candidate cells: walk along the segment and collect the
+        // cells of the buckets around it
+        std::set<unsigned int> visited;
+        const unsigned int n_steps = 1 + static_cast<unsigned int>(2.0 * length / cell_bucket_size);
+        for (unsigned int k = 0; k <= n_steps; ++k)
+          {
+            const Point<dim> x = p + (static_cast<double>(k)/n_steps) * (q - p);
+            const int bx = static_cast<int>(std::floor(x[0]/cell_bucket_size));
+            const int by = static_cast<int>(std::floor(x[1]/cell_bucket_size));
+            for (int i = bx-1; i <= bx+1; ++i)
+              for (int j = by-1; j <= by+1; ++j)
+                {
+                  typename std::map<std::pair<int,int>,
+                           std::vector<typename DoFHandler<dim>::active_cell_iterator> >::const_iterator
+                           bucket = cell_buckets.find(std::make_pair(i,j));
+                  if (bucket == cell_buckets.end())
+                    continue;
+
+                  for (unsigned int c = 0; c < bucket->second.size(); ++c)
+                    {
+                      const typename DoFHandler<dim>::active_cell_iterator &cell = bucket->second[c];
+                      if (!visited.insert(cell->active_cell_index()).second)
+                        continue;
+
+                      double t0, t1;
+                      bool on_face;
+                      if (!clip_segment_to_cell<dim>(cell, p, q, t0, t1, on_face))
+                        continue;
+
+                      cell->get_dof_values(rel_solution, cell_dof_values);
+
+                      for (unsigned int qp = 0; qp < n_q_points; ++qp)
+                        {
+                          const double t = t0 + (t1 - t0) * line_quadrature.point(qp)[0];
+                          Point<dim> unit_point;
+                          try
+                            {
+                              unit_point = StaticMappingQ1<dim>::mapping
+                                           .transform_real_to_unit_cell(cell, p + t * (q - p));
+                            }
+                          catch (const typename Mapping<dim>::ExcTransformationFailed &)
+                            {
+                              continue;
+                            }
+                          unit_point = GeometryInfo<dim>::project_to_unit_cell(unit_point);
+
+                          // Jacobian of the bilinear mapping, the gradient
+                          // of the phase field is J^{-T} times the one on
+                          // the unit cell
+                          Tensor<2, dim> jacobian;
+                          for (unsigned int v = 0; v < GeometryInfo<dim>::vertices_per_cell; ++v)
+                            jacobian += outer_product(cell->vertex(v),
+                                                      GeometryInfo<dim>::d_linear_shape_function_gradient(unit_point, v));
+
+                          Tensor<1, dim> u, unit_grad_pf;
+                          for (unsigned int k = 0; k < fe.dofs_per_cell; ++k)
+                            {
+                              const unsigned int comp = fe.system_to_component_index(k).first;
+                              if (comp < dim)
+                                u[comp] += cell_dof_values(k) * fe.shape_value(k, unit_point);
+                              else
+                                unit_grad_pf += cell_dof_values(k) * fe.shape_grad(k, unit_point);
+                            }
+                          const Tensor<1, dim> grad_pf = transpose(invert(jacobian)) * unit_grad_pf;
+
+                          const double weight = (on_face ? 0.5 : 1.0)
+                                                * (t1 - t0) * length * line_quadrature.weight(qp);
+                          local_values[l] += 0.5 * u * grad_pf * weight;
+                        }
+                    }
+                }
+          }
+      }
+
+  std::vector<double> values(polylines.size());
+  Utilities::MPI::sum(local_values, mpi_com, values);
+  return values;
+}
+
+
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::build_boundary_faces ()
+{
+  boundary_faces.clear();
+
+  typename DoFHandler<dim>::active_cell_iterator
+  cell = dof_handler.begin_active(),
+  endc = dof_handler.end();
+  for (; cell!=endc; ++cell)
+    if (cell->is_locally_owned() && cell->at_boundary())
+      for (unsigned int face=0; face<GeometryInfo<dim>::faces_per_cell; ++face)
+        if (cell->face(face)->at_boundary())
+          boundary_faces[cell->face(face)->boundary_id()].push_back(std::make_pair(cell, face));
+
+  boundary_faces_valid = true;
+}
+
+
+// Quantities of interest after each time step, computed in one sweep
+// over the cells and the (precomputed) faces on boundary 3, and summed
+// over all processors in one reduction:
+// bulk energy = [(1+k)phi^2 + k] psi(e)
+// crack energy = \frac{G_c}{2}\int_{\Omega}\Bigl( \frac{(\varphi - 1)^2}{\eps}
+//+ \eps |\nabla \varphi|^2 \Bigr) \, dx
+// and the load (surface traction) on boundary 3 for the Miehe tests.
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::compute_energy_and_load ()
+{
+  const bool with_load = (test_case == TestCase::miehe_tension
+                          || test_case == TestCase::miehe_shear);
+
+  // bulk energy, crack energy, load x, load y
+  std::vector<double> local_values(2+dim, 0.0);
+
+  LA::MPI::BlockVector rel_solution(partition_relevant, mpi_com);
+  rel_solution = solution;
+
+  const QGauss<dim> quadrature_formula(degree+2);
+  const unsigned int n_q_points = quadrature_formula.size();
+
+  FEValues<dim> fe_values(fe, quadrature_formula,
+                          update_values | update_quadrature_points | update_JxW_values
+                          | update_gradients);
+
+  std::vector<Vector<double> > solution_values(n_q_points,
+                                               Vector<double>(dim+1));
+
+  std::vector<std::vector<Tensor<1, dim> > > solution_grads(
+    n_q_points, std::vector<Tensor<1, dim> >(dim+1));
+
+  typename DoFHandler<dim>::active_cell_iterator cell =
+    dof_handler.begin_active(), endc = dof_handler.end();
+
+  for (; cell != endc; ++cell)
+    if (cell->is_locally_owned())
+      {
+        fe_values.reinit(cell);
+
+        // update lame coefficients based on current cell
+        if (test_case == TestCase::multiple_het)
+          {
+            E_modulus = func_emodulus->value(cell->center(), 0);
+
+            lame_coefficient_mu = E_modulus / (2.0 * (1 + poisson_ratio_nu));
+
+            lame_coefficient_lambda = (2 * poisson_ratio_nu * lame_coefficient_mu)
+                                      / (1.0 - 2 * poisson_ratio_nu);
+          }
+
+        fe_values.get_function_values(rel_solution, solution_values);
+        fe_values.get_function_gradients(rel_solution, solution_grads);
+
+        for (unsigned int q = 0; q < n_q_points; ++q)
+          {
+            const Tensor<2,dim> grad_u = Tensors
+                                         ::get_grad_u<dim> (q, solution_grads);
+
+            const Tensor<2,dim> E = 0.5 * (grad_u + transpose(grad_u));
+            const double tr_E = grad_u[0][0] + grad_u[1][1];
+
+            const double pf = solution_values[q](dim);
+
+            const double tr_e_2 = trace(E*E);
+
+            const double psi_e = 0.5 * lame_coefficient_lambda * tr_E*tr_E + lame_coefficient_mu * tr_e_2;
+
+            local_values[0] += ((1+constant_k)*pf*pf+constant_k) * psi_e * fe_values.JxW(q);
+
+            local_values[1] += G_c/2.0 * ((pf-1) * (pf-1)/alpha_eps + alpha_eps * scalar_product(grad_u, grad_u))
+                               * fe_values.JxW(q);
+          }
+      }
+
+  if (with_load)
+    {
+      if (!boundary_faces_valid)
+        build_boundary_faces();
+
+      const QGauss<dim-1> face_quadrature_formula (3);
+      FEFaceValues<dim> fe_face_values (fe, face_quadrature_formula,
+                                        update_values | update_gradients | update_normal_vectors |
+                                        update_JxW_values);
+      const unsigned int n_face_q_points = face_quadrature_formula.size();
+
+      std::vector<std::vector<Tensor<1,dim> > >
+      face_solution_grads (n_face_q_points, std::vector<Tensor<1,dim> > (dim+1));
+
+      const Tensor<2, dim> Identity =
+        Tensors::get_Identity<dim>();
+
+      const std::vector<std::pair<typename DoFHandler<dim>::active_cell_iterator, unsigned int> >
+      &faces = boundary_faces[3];
+      for (unsigned int f = 0; f < faces.size(); ++f)
+        {
+          fe_face_values.reinit (faces[f].first, faces[f].second);
+          fe_face_values.get_function_gradients (rel_solution, face_solution_grads);
+
+          for (unsigned int q_point=0; q_point<n_face_q_points; ++q_point)
+            {
+              const Tensor<2, dim> grad_u
+                = Tensors::get_grad_u<dim>(q_point, face_solution_grads);
+
+              const Tensor<2, dim> E = 0.5 * (grad_u + transpose(grad_u));
+              const double tr_E = grad_u[0][0] + grad_u[1][1];
+
+              Tensor<2, dim> stress_term;
+              stress_term = lame_coefficient_lambda * tr_E * Identity
+                            + 2 * lame_coefficient_mu * E;
+
+              const Tensor<1, dim> traction = stress_term *
+                                              fe_face_values.normal_vector(q_point)* fe_face_values.JxW(q_point);
+              for (unsigned int d = 0; d < dim; ++d)
+                local_values[2+d] += traction[d];
+            }
+        }
+    }
+
+  std::vector<double> values(local_values.size());
+  Utilities::MPI::sum(local_values, mpi_com, values);
+
+  bulk_energy = values[0];
+  crack_energy = values[1];
+  for (unsigned int d = 0; d < dim; ++d)
+    load[d] = values[2+d];
+
+  pcout << "No " << timestep_number << " time " << time
+        << " bulk energy: " << values[0]
+        << " crack energy: " << values[1];
+
+  if (test_case == TestCase::miehe_tension)
+    {
+      pcout << "  Load y: " << values[3] << std::endl;
+    }
+  else if (test_case == TestCase::miehe_shear)
+    {
+      pcout << "  Load x: " << -values[2] << std::endl;
+    }
+}
+
+// Find the locally owned cells containing the probe points with the
+// rtree of the grid cache. The cell found may be a ghost cell although
+// the point is on the boundary of a locally owned cell, so these are
+// checked as well. Points on the boundary between processors are taken
+// by the processor with the lowest rank.
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::locate_probes ()
+{
+  local_probes.clear();
+  const unsigned int my_rank = Utilities::MPI::this_mpi_process(mpi_com);
+  std::vector<unsigned int> owner(probe_points.size(), numbers::invalid_unsigned_int);
+  std::vector<std::pair<typename DoFHandler<dim>::active_cell_iterator, Point<dim> > >
+  found(probe_points.size());
+
+  const std::vector<std::set<typename Triangulation<dim>::active_cell_iterator> >
+  &vertex_to_cells = grid_cache.get_vertex_to_cell_map();
+
+  for (unsigned int i = 0; i < probe_points.size(); ++i)
+    {
+      std::pair<typename Triangulation<dim>::active_cell_iterator, Point<dim> > cell_and_point;
+      try
+        {
+          cell_and_point = GridTools::find_active_cell_around_point(grid_cache, probe_points[i]);
+        }
+      catch (const GridTools::ExcPointNotFound<dim> &)
+        {
+          continue;
+        }
+
+      if (!cell_and_point.first->is_locally_owned())
+        for (unsigned int v = 0; v < GeometryInfo<dim>::vertices_per_cell
+             && !cell_and_point.first->is_locally_owned(); ++v)
+          {
+            typename std::set<typename Triangulation<dim>::active_cell_iterator>::const_iterator
+            it = vertex_to_cells[cell_and_point.first->vertex_index(v)].begin();
+            for (; it != vertex_to_cells[cell_and_point.first->vertex_index(v)].end(); ++it)
+              if ((*it)->is_locally_owned())
+                {
+                  Point<dim> unit_point;
+                  try
+                    {
+                      unit_point = StaticMappingQ1<dim>::mapping
+                                   .transform_real_to_unit_cell(*it, probe_points[i]);
+                    }
+                  catch (const typename Mapping<dim>::ExcTransformationFailed &)
+                    {
+                      continue;
+                    }
+                  if (GeometryInfo<dim>::is_inside_unit_cell(unit_point, 1.0e-10))
+                    {
+                      cell_and_point = std::make_pair(*it, unit_point);
+                      break;
+                    }
+                }
+          }
+
+      if (cell_and_point.first->is_locally_owned())
+        {
+          owner[i] = my_rank;
+          found[i] = std::make_pair(typename DoFHandler<dim>::active_cell_iterator(
+                                      &triangulation, cell_and_point.first->level(),
+                                      cell_and_point.first->index(), &dof_handler),
+                                    GeometryInfo<dim>::project_to_unit_cell(cell_and_point.second));
+        }
+    }
+
+  std::vector<unsigned int> global_owner(probe_points.size());
+  Utilities::MPI::min(owner, mpi_com, global_owner);
+  for (unsigned int i = 0; i < probe_points.size(); ++i)
+    {
+      if (global_owner[i] == numbers::invalid_unsigned_int)
+        pcout << "Probe point " << probe_points[i] << " is not in the domain" << std::endl;
+      else if (global_owner[i] == my_rank)
+        local_probes.push_back(std::make_pair(i, found[i]));
+    }
+
+  probes_valid = true;
+}
+
+
+// Evaluate displacements and phase field at all probe points in one
+// pass over the locally owned probes and one reduction, and append
+// them as one line to the time series.
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::write_probe_values ()
+{
+  if (!probes_valid)
+    locate_probes();
+
+  LA::MPI::BlockVector rel_solution(partition_relevant, mpi_com);
+  rel_solution = solution;
+
+  std::vector<double> local_values(probe_points.size() * (dim+1), 0.0);
+  std::vector<Vector<double> > point_value(1, Vector<double>(dim+1));
+  for (unsigned int k = 0; k < local_probes.size(); ++k)
+    {
+      FEValues<dim> fe_values(fe,
+                              Quadrature<dim>(std::vector<Point<dim> >(1, local_probes[k].second.second)),
+                              update_values);
+      fe_values.reinit(local_probes[k].second.first);
+      fe_values.get_function_values(rel_solution, point_value);
+      for (unsigned int c = 0; c < dim+1; ++c)
+        local_values[local_probes[k].first * (dim+1) + c] = point_value[0](c);
     }
 
-  // this yields 100 quadrature points evenly distributed in the interior of the cell.
-  // We avoid points on the faces, as they would be counted more than once.
-  const unsigned int n_reps = 50 + 100.0 * min_cell_diameter / (1.0/n_buckets);
-  const QIterated<dim> quadrature_formula (QMidpoint<1>(), 100 );
-  const unsigned int n_q_points = quadrature_formula.size();
-
-  LA::MPI::BlockVector rel_solution(partition_relevant);
-  rel_solution = solution;
+  std::vector<double> values(local_values.size());
+  Utilities::MPI::sum(local_values, mpi_com, values);
 
-  FEValues<dim> fe_values(fe, quadrature_formula,
-                          update_values | update_quadrature_points | update_JxW_values
-                          | update_gradients);
+  if (Utilities::MPI::this_mpi_process(mpi_com) == 0)
+    {
+      const std::string filename = output_directory + "/" + filename_basis + "probes.txt";
+      std::ofstream f(filename.c_str(), new_probe_file ? std::ios::out : std::ios::app);
+      if (new_probe_file)
+        {
+          f << "# time";
+          for (unsigned int i = 0; i < probe_points.size(); ++i)
+            f << "   ux(" << probe_points[i] << ") uy(" << probe_points[i]
+              << ") phi(" << probe_points[i] << ")";
+          f << std::endl;
+          new_probe_file = false;
+        }
 
+      f << time;
+      for (unsigned int i = 0; i < values.size(); ++i)
+        f << " " << values[i];
+      f << std::endl;
+    }
+}
 
-  typename DoFHandler<dim>::active_cell_iterator cell =
-    dof_handler.begin_active(), endc = dof_handler.end();
 
-  std::vector<Vector<double> > solution_values(n_q_points,
-                                               Vector<double>(dim+1));
+// Sample the phase field on a uniform pixel grid over the bounding box
+// of the domain and write it as gray scale image (0 = broken, 255 =
+// intact) in the .pgm format read by BitmapFile. Pixel (i,j) is at
+// x0 + i*hx, y0 + j*hy like in BitmapFile. Each processor samples
+// its locally owned cells, pixels outside of them stay at 255, and the
+// image is put together with one reduction onto the first processor.
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::write_phase_field_raster ()
+{
+  Assert(dim==2, ExcNotImplemented());
+
+  // bounding box of the coarse mesh
+  typename DoFHandler<dim>::cell_iterator coarse_cell = dof_handler.begin(0);
+  Point<dim> lower = coarse_cell->vertex(0), upper = coarse_cell->vertex(0);
+  for (; coarse_cell != dof_handler.end(0); ++coarse_cell)
+    for (unsigned int v = 0; v < GeometryInfo<dim>::vertices_per_cell; ++v)
+      for (unsigned int d = 0; d < dim; ++d)
+        {
+          lower[d] = std::min(lower[d], coarse_cell->vertex(v)[d]);
+          upper[d] = std::max(upper[d], coarse_cell->vertex(v)[d]);
+        }
 
-  std::vector<std::vector<Tensor<1, dim> > > solution_grads(
-    n_q_points, std::vector<Tensor<1, dim> >(dim+1));
+  const double longer_side = std::max(upper[0] - lower[0], upper[1] - lower[1]);
+  const int nx = std::max(2, static_cast<int>(
+                            std::round(raster_resolution * (upper[0] - lower[0]) / longer_side)));
+  const int ny = std::max(2, static_cast<int>(
+                            std::round(raster_resolution * (upper[1] - lower[1]) / longer_side)));
+  const double hx = (upper[0] - lower[0]) / (nx - 1);
+  const double hy = (upper[1] - lower[1]) / (ny - 1);
 
+  LA::MPI::BlockVector rel_solution(partition_relevant, mpi_com);
+  rel_solution = solution;
 
-  const double width = bucket_to_value(1, n_buckets) - bucket_to_value(0, n_buckets);
+  // rows from top to bottom as in the file
+  std::vector<unsigned char> local_image(nx * ny, 255);
+  Vector<double> local_values(fe.dofs_per_cell);
 
+  typename DoFHandler<dim>::active_cell_iterator cell =
+    dof_handler.begin_active(), endc = dof_handler.end();
   for (; cell != endc; ++cell)
     if (cell->is_locally_owned())
       {
+        Point<dim> cell_lower = cell->vertex(0), cell_upper = cell->vertex(0);
+        for (unsigned int v = 1; v < GeometryInfo<dim>::vertices_per_cell; ++v)
+          for (unsigned int d = 0; d < dim; ++d)
+            {
+              cell_lower[d] = std::min(cell_lower[d], cell->vertex(v)[d]);
+              cell_upper[d] = std::max(cell_upper[d], cell->vertex(v)[d]);
+            }
 
-        fe_values.reinit(cell);
-
-        fe_values.get_function_values(rel_solution,
-                                      solution_values);
-        fe_values.get_function_gradients(
-          rel_solution, solution_grads);
-
-        for (unsigned int q = 0; q < n_q_points; ++q)
-          {
-            const int idx_ = value_to_bucket(fe_values.quadrature_point(q)[0], n_buckets);
-            if (idx_<0 || idx_>=static_cast<int>(n_buckets))
-              continue;
-            const unsigned int idx = static_cast<unsigned int>(idx_);
+        const int i_begin = std::max(0, static_cast<int>(std::ceil((cell_lower[0] - lower[0]) / hx)));
+        const int i_end = std::min(nx - 1, static_cast<int>(std::floor((cell_upper[0] - lower[0]) / hx)));
+        const int j_begin = std::max(0, static_cast<int>(std::ceil((cell_lower[1] - lower[1]) / hy)));
+        const int j_end = std::min(ny - 1, static_cast<int>(std::floor((cell_upper[1] - lower[1]) / hy)));
+        if (i_begin > i_end || j_begin > j_end)
+          continue;
 
-            const Tensor<1, dim> u = Tensors::get_u<dim>(
-                                       q, solution_values);
+        cell->get_dof_values(rel_solution, local_values);
 
-            const Tensor<1, dim> grad_pf =
-              Tensors::get_grad_pf<dim>(q,
-                                        solution_grads);
+        for (int j = j_begin; j <= j_end; ++j)
+          for (int i = i_begin; i <= i_end; ++i)
+            {
+              Point<dim> p;
+              p[0] = lower[0] + i * hx;
+              p[1] = lower[1] + j * hy;
 
-            double cod_value =
-              // Motivated by Bourdin et al. (2012); SPE Paper
-              u * grad_pf;
+              Point<dim> unit_point;
+              try
+                {
+                  unit_point = StaticMappingQ1<dim>::mapping
+                               .transform_real_to_unit_cell(cell, p);
+                }
+              catch (const typename Mapping<dim>::ExcTransformationFailed &)
+                {
+                  continue;
+                }
+              if (!GeometryInfo<dim>::is_inside_unit_cell(unit_point, 1.0e-10))
+                continue;
 
-            values[idx] += cod_value * fe_values.JxW(q);
-            volume[idx] += fe_values.JxW(q);
-          }
+              double pf = 0.0;
+              for (unsigned int k = 0; k < fe.dofs_per_cell; ++k)
+                if (fe.system_to_component_index(k).first == dim)
+                  pf += local_values(k) * fe.shape_value(k, unit_point);
 
+              const unsigned char gray = static_cast<unsigned char>(
+                                           std::round(255.0 * std::min(std::max(pf, 0.0), 1.0)));
+              unsigned char &pixel = local_image[nx * (ny - 1 - j) + i];
+              pixel = std::min(pixel, gray);
+            }
       }
 
-  std::vector<double> values_all(n_buckets);
-  std::vector<double> volume_all(n_buckets);
-  Utilities::MPI::sum(values, mpi_com, values_all);
-  Utilities::MPI::sum(volume, mpi_com, volume_all);
-  for (unsigned int i=0; i<n_buckets; ++i)
-    values[i] = values_all[i] / width / 2.0;
-
-  double middle_value = compute_cod(2.0);
+  std::vector<unsigned char> image(nx * ny);
+  MPI_Reduce(local_image.data(), image.data(), nx * ny, MPI_UNSIGNED_CHAR,
+             MPI_MIN, 0, mpi_com);
 
   if (Utilities::MPI::this_mpi_process(mpi_com) == 0)
     {
-      static unsigned int no = 0;
-      ++no;
-      std::ostringstream filename;
-      filename <<  "cod-" << Utilities::int_to_string(no, 2) << ".txt";
-      pcout << "writing " << filename.str() << std::endl;
-      std::ofstream f(filename.str().c_str());
-
-      double error = 0.0;
-      for (unsigned int i=0; i<n_buckets; ++i)
+      const std::string filename = output_directory + "/" + filename_basis + "phasefield-"
+                                   + Utilities::int_to_string(timestep_number, 5) + ".pgm";
+      std::ofstream f(filename.c_str());
+      f << "P2" << std::endl
+        << "# phase field at time " << time << std::endl
+        << nx << " " << ny << std::endl
+        << 255 << std::endl;
+      for (int j = 0; j < ny; ++j)
         {
-          error += std::pow(values[i]-exact[i], 2.0);
-          f << bucket_to_value(i, n_buckets) << " " << values[i] << " " << exact[i] << std::endl;
+          for (int i = 0; i < nx; ++i)
+            f << static_cast<unsigned int>(image[nx * j + i]) << (i < nx - 1 ? " " : "");
+          f << std::endl;
         }
-      error = std::sqrt(error);
-      double err_middle = std::abs(middle_value-3.84e-4);
-      pcout << "ERROR: " << error
-            << " alpha_eps: " << alpha_eps
-            << " k: " << constant_k
-            << " hmin: " << min_cell_diameter
-            << " errmiddle: " << err_middle
-            << " dofs: " << dof_handler.n_dofs()
-            << std::endl;
-
     }
 }
 
+
+// Extract the crack path as isoline of the phase field with marching
+// squares on the vertex values of the locally owned cells. The segments
+// of all processors are gathered on the first processor and stitched
+// into polylines at common end points, which are written to
+// output/<basis>crackpath-NNNNN.txt. The isoline goes around the crack,
+// so the crack length is taken as half its length. The tips of a crack
+// inside the domain, a closed isoline, are the two points farthest
+// apart. The isoline around a crack starting at the boundary ends on
+// the boundary, and its single tip is the point farthest from there.
 template <int dim>
-double
-FracturePhaseFieldProblem<dim>::compute_cod (
-  const double eval_line)
+void
+FracturePhaseFieldProblem<dim>::write_crack_path ()
 {
+  Assert(dim==2, ExcNotImplemented());
+  const double threshold = value_phase_field_for_crack_path;
 
-  const QGauss<dim - 1> face_quadrature_formula(3);
-  FEFaceValues<dim> fe_face_values(fe, face_quadrature_formula,
-                                   update_values | update_quadrature_points | update_gradients
-                                   | update_normal_vectors | update_JxW_values);
-
-
-  LA::MPI::BlockVector rel_solution(partition_relevant);
+  LA::MPI::BlockVector rel_solution(partition_relevant, mpi_com);
   rel_solution = solution;
 
-  const unsigned int dofs_per_cell = fe.dofs_per_cell;
-  const unsigned int n_face_q_points = face_quadrature_formula.size();
-
-  std::vector<unsigned int> local_dof_indices(dofs_per_cell);
-
-  std::vector<Vector<double> > face_solution_values(n_face_q_points,
-                                                    Vector<double>(dim+1));
-  std::vector<std::vector<Tensor<1, dim> > > face_solution_grads(
-    n_face_q_points, std::vector<Tensor<1, dim> >(dim+1));
-
-  double cod_value = 0.0;
-  double eps = 1.0e-6;
+  // vertices in counterclockwise order and the edges between them,
+  // with the faces these edges are
+  const unsigned int cycle[4] = {0, 1, 3, 2};
+  const unsigned int edge_face[4] = {2, 1, 3, 0};
 
+  // end points of the segments and whether they are on the boundary:
+  // x0 y0 b0 x1 y1 b1
+  std::vector<double> local_segments;
   typename DoFHandler<dim>::active_cell_iterator cell =
     dof_handler.begin_active(), endc = dof_handler.end();
-
   for (; cell != endc; ++cell)
     if (cell->is_locally_owned())
       {
-        for (unsigned int face = 0; face < GeometryInfo<dim>::faces_per_cell;
-             ++face)
+        double value[4];
+        double center_value = 0.0;
+        for (unsigned int v = 0; v < 4; ++v)
+          {
+            value[v] = rel_solution(cell->vertex_dof_index(v, dim));
+            center_value += 0.25 * value[v];
+          }
+
+        std::vector<Point<dim> > crossings;
+        std::vector<double> crossing_at_boundary;
+        for (unsigned int e = 0; e < 4; ++e)
           {
-            fe_face_values.reinit(cell, face);
-            fe_face_values.get_function_values(rel_solution,
-                                               face_solution_values);
-            fe_face_values.get_function_gradients(rel_solution,
-                                                  face_solution_grads);
-
-            for (unsigned int q_point = 0; q_point < n_face_q_points;
-                 ++q_point)
+            const unsigned int a = cycle[e], b = cycle[(e+1) % 4];
+            if ((value[a] < threshold) != (value[b] < threshold))
               {
-                if ((fe_face_values.quadrature_point(q_point)[0]
-                     < (eval_line + eps))
-                    && (fe_face_values.quadrature_point(q_point)[0]
-                        > (eval_line - eps)))
-                  {
-                    const Tensor<1, dim> u = Tensors::get_u<dim>(
-                                               q_point, face_solution_values);
+                const double t = (threshold - value[a]) / (value[b] - value[a]);
+                crossings.push_back(cell->vertex(a) + t * (cell->vertex(b) - cell->vertex(a)));
+                crossing_at_boundary.push_back(cell->at_boundary(edge_face[e]) ? 1.0 : 0.0);
+              }
+          }
+
+        if (crossings.size() == 2)
+          {
+            for (unsigned int k = 0; k < 2; ++k)
+              {
+                local_segments.push_back(crossings[k][0]);
+                local_segments.push_back(crossings[k][1]);
+                local_segments.push_back(crossing_at_boundary[k]);
+              }
+          }
+        else if (crossings.size() == 4)
+          {
+            // saddle: if the center is on the side of vertices 0 and 3,
+            // these are connected and vertices 1 and 2 are cut off
+            const unsigned int first = ((center_value < threshold) == (value[0] < threshold)) ? 0 : 3;
+            for (unsigned int k = 0; k < 4; ++k)
+              {
+                const unsigned int c = (first + k) % 4;
+                local_segments.push_back(crossings[c][0]);
+                local_segments.push_back(crossings[c][1]);
+                local_segments.push_back(crossing_at_boundary[c]);
+              }
+          }
+      }
 
-                    const Tensor<1, dim> grad_pf =
-                      Tensors::get_grad_pf<dim>(q_point,
-                                                face_solution_grads);
+  const std::vector<std::vector<double> > all_segments
+    = Utilities::MPI::gather(mpi_com, local_segments, 0);
+  if (Utilities::MPI::this_mpi_process(mpi_com) != 0)
+    return;
+
+  std::vector<Point<dim> > segments;
+  std::vector<bool> at_boundary;
+  for (unsigned int r = 0; r < all_segments.size(); ++r)
+    for (unsigned int k = 0; k + 2 < all_segments[r].size(); k += 3)
+      {
+        segments.push_back(Point<dim>(all_segments[r][k], all_segments[r][k+1]));
+        at_boundary.push_back(all_segments[r][k+2] > 0.5);
+      }
+  const unsigned int n_segments = segments.size() / 2;
+
+  // end points are the same up to round-off, identify them on a fine
+  // grid relative to the size of the domain. Two end points closer
+  // than the grid size may fall into neighboring bins, so these are
+  // searched as well.
+  double diameter = 0.0;
+  for (typename DoFHandler<dim>::cell_iterator coarse_cell = dof_handler.begin(0);
+       coarse_cell != dof_handler.end(0); ++coarse_cell)
+    diameter = std::max(diameter, coarse_cell->diameter());
+  const double tolerance = 1.0e-9 * diameter;
+
+  std::map<std::pair<long long, long long>, std::vector<unsigned int> > bins;
+  std::vector<std::pair<long long, long long> > keys(segments.size());
+  for (unsigned int k = 0; k < segments.size(); ++k)
+    {
+      keys[k] = std::make_pair(std::llround(segments[k][0] / tolerance),
+                               std::llround(segments[k][1] / tolerance));
+      bins[keys[k]].push_back(k);
+    }
 
-                    // Motivated by Bourdin et al. (2012); SPE Paper
-                    cod_value += 0.5 * u * grad_pf
-                                 * fe_face_values.JxW(q_point);
+  std::vector<std::vector<unsigned int> > end_points(segments.size());
+  for (unsigned int k = 0; k < segments.size(); ++k)
+    for (long long i = keys[k].first-1; i <= keys[k].first+1; ++i)
+      for (long long j = keys[k].second-1; j <= keys[k].second+1; ++j)
+        {
+          const typename std::map<std::pair<long long, long long>,
+                std::vector<unsigned int> >::const_iterator
+                bin = bins.find(std::make_pair(i,j));
+          if (bin == bins.end())
+            continue;
+          for (unsigned int n = 0; n < bin->second.size(); ++n)
+            if (segments[bin->second[n]].distance(segments[k]) <= 2.0 * tolerance)
+              end_points[k].push_back(bin->second[n]);
+        }
 
-                  }
+  // walk along the segments, starting at open ends first, then
+  // through the remaining closed loops
+  std::vector<bool> used(n_segments, false);
+  std::vector<std::vector<Point<dim> > > polylines;
+  std::vector<std::vector<bool> > polylines_at_boundary;
+  for (unsigned int pass = 0; pass < 2; ++pass)
+    for (unsigned int k = 0; k < segments.size(); ++k)
+      {
+        if (used[k/2] || (pass == 0 && end_points[k].size() != 1))
+          continue;
 
-              }
+        std::vector<Point<dim> > polyline(1, segments[k]);
+        std::vector<bool> polyline_at_boundary(1, at_boundary[k]);
+        unsigned int end = k;
+        while (!used[end/2])
+          {
+            used[end/2] = true;
+            const unsigned int other = end ^ 1;
+            polyline.push_back(segments[other]);
+            polyline_at_boundary.push_back(at_boundary[other]);
+
+            const std::vector<unsigned int> &next = end_points[other];
+            for (unsigned int n = 0; n < next.size(); ++n)
+              if (!used[next[n]/2])
+                {
+                  end = next[n];
+                  break;
+                }
           }
+        polylines.push_back(polyline);
+        polylines_at_boundary.push_back(polyline_at_boundary);
       }
 
-  cod_value = Utilities::MPI::sum(cod_value, mpi_com) / 2.0;
-
-  pcout << eval_line << "  " << cod_value << std::endl;
+  const std::string filename = output_directory + "/" + filename_basis + "crackpath-"
+                               + Utilities::int_to_string(timestep_number, 5) + ".txt";
+  std::ofstream f(filename.c_str());
+  f << "# isoline phase field = " << threshold << " at time " << time << std::endl;
 
-  return cod_value;
+  double total_length = 0.0;
+  for (unsigned int c = 0; c < polylines.size(); ++c)
+    {
+      const std::vector<Point<dim> > &polyline = polylines[c];
+      double length = 0.0;
+      for (unsigned int k = 1; k < polyline.size(); ++k)
+        length += polyline[k].distance(polyline[k-1]);
+      total_length += 0.5 * length;
+
+      // tips: farthest point from the start, and for a closed isoline
+      // the farthest point from that one. An isoline starting on the
+      // boundary has a single tip, points on the boundary are none.
+      const std::vector<bool> &on_boundary = polylines_at_boundary[c];
+      const bool edge_crack = on_boundary.front() || on_boundary.back();
+      const unsigned int start = (on_boundary.front() || !on_boundary.back())
+                                 ? 0 : polyline.size()-1;
+      unsigned int tip_a = start, tip_b = start;
+      for (unsigned int k = 0; k < polyline.size(); ++k)
+        if (!on_boundary[k]
+            && (on_boundary[tip_a]
+                || polyline[k].distance(polyline[start]) > polyline[tip_a].distance(polyline[start])))
+          tip_a = k;
+      for (unsigned int k = 0; k < polyline.size(); ++k)
+        if (!on_boundary[k]
+            && polyline[k].distance(polyline[tip_a]) > polyline[tip_b].distance(polyline[tip_a]))
+          tip_b = k;
+
+      pcout << "Crack " << c << ": length " << 0.5 * length
+            << " tips (" << polyline[tip_a] << ")";
+      if (!edge_crack)
+        pcout << " (" << polyline[tip_b] << ")";
+      pcout << std::endl;
+
+      f << "# crack " << c << " length " << 0.5 * length << std::endl;
+      for (unsigned int k = 0; k < polyline.size(); ++k)
+        f << polyline[k] << std::endl;
+      f << std::endl;
+    }
 
+  pcout << "Crack path: " << polylines.size() << " cracks, total length "
+        << total_length << std::endl;
 }
 
 
+// Connected components of the crack cells (mean of the phase field at
+// the vertices below the threshold) with face neighbors as connections.
+// Each processor labels the components of its locally owned cells with
+// a union-find, the labels are numbered globally and sent to the ghost
+// cells. The pairs of labels meeting at processor boundaries are
+// gathered on all processors, which join them in the same order and so
+// number the components alike.
+// As the phase field does not grow, a point inside a component stays
+// in a crack cell. Two of these points of the last step ending up in
+// the same component mark a merge.
 template <int dim>
-double
-FracturePhaseFieldProblem<dim>::compute_energy()
+void
+FracturePhaseFieldProblem<dim>::label_crack_components ()
 {
-  // What are we computing? In Latex-style it is:
-  // bulk energy = [(1+k)phi^2 + k] psi(e)
-  // crack energy = \frac{G_c}{2}\int_{\Omega}\Bigl( \frac{(\varphi - 1)^2}{\eps}
-  //+ \eps |\nabla \varphi|^2 \Bigr) \, dx
-  double local_bulk_energy = 0.0;
-  double local_crack_energy = 0.0;
-
-  const QGauss<dim> quadrature_formula(degree+2);
-  const unsigned int n_q_points = quadrature_formula.size();
+  const unsigned int invalid = numbers::invalid_unsigned_int;
+  const unsigned int my_rank = Utilities::MPI::this_mpi_process(mpi_com);
 
-  FEValues<dim> fe_values(fe, quadrature_formula,
-                          update_values | update_quadrature_points | update_JxW_values
-                          | update_gradients);
+  LA::MPI::BlockVector rel_solution(partition_relevant, mpi_com);
+  rel_solution = solution;
 
+  // union-find over the locally owned crack cells by active cell index
+  std::vector<unsigned int> parent(triangulation.n_active_cells(), invalid);
   typename DoFHandler<dim>::active_cell_iterator cell =
     dof_handler.begin_active(), endc = dof_handler.end();
-
-  LA::MPI::BlockVector rel_solution(partition_relevant);
-  rel_solution = solution;
-
-  std::vector<Vector<double> > solution_values(n_q_points,
-                                               Vector<double>(dim+1));
-
-  std::vector<std::vector<Tensor<1, dim> > > solution_grads(
-    n_q_points, std::vector<Tensor<1, dim> >(dim+1));
-
   for (; cell != endc; ++cell)
     if (cell->is_locally_owned())
       {
-        fe_values.reinit(cell);
+        double mean_value = 0.0;
+        for (unsigned int v = 0; v < GeometryInfo<dim>::vertices_per_cell; ++v)
+          mean_value += rel_solution(cell->vertex_dof_index(v, dim))
+                        / GeometryInfo<dim>::vertices_per_cell;
+        if (mean_value < value_phase_field_for_crack_components)
+          parent[cell->active_cell_index()] = cell->active_cell_index();
+      }
 
-        // update lame coefficients based on current cell
-        if (test_case == TestCase::multiple_het)
-          {
-            E_modulus = func_emodulus->value(cell->center(), 0);
+  // the face neighbors of a cell: active cells of the same or the
+  // coarser level, or the children on the face
+  std::vector<typename DoFHandler<dim>::active_cell_iterator> neighbors;
+  const auto collect_neighbors = [&](const typename DoFHandler<dim>::active_cell_iterator &c)
+  {
+    neighbors.clear();
+    for (unsigned int f = 0; f < GeometryInfo<dim>::faces_per_cell; ++f)
+      if (!c->at_boundary(f))
+        {
+          if (c->neighbor(f)->has_children())
+            {
+              for (unsigned int sf = 0; sf < c->face(f)->n_children(); ++sf)
+                neighbors.push_back(c->neighbor_child_on_subface(f, sf));
+            }
+          else
+            neighbors.push_back(c->neighbor(f));
+        }
+  };
 
-            lame_coefficient_mu = E_modulus / (2.0 * (1 + poisson_ratio_nu));
+  for (cell = dof_handler.begin_active(); cell != endc; ++cell)
+    if (cell->is_locally_owned() && parent[cell->active_cell_index()] != invalid)
+      {
+        collect_neighbors(cell);
+        for (unsigned int n = 0; n < neighbors.size(); ++n)
+          if (neighbors[n]->is_locally_owned()
+              && parent[neighbors[n]->active_cell_index()] != invalid)
+            parent[find_root(parent, cell->active_cell_index())]
+              = find_root(parent, neighbors[n]->active_cell_index());
+      }
 
-            lame_coefficient_lambda = (2 * poisson_ratio_nu * lame_coefficient_mu)
-                                      / (1.0 - 2 * poisson_ratio_nu);
-          }
+  // number the local components consecutively after the ones of the
+  // processors with lower rank
+  std::vector<unsigned int> label(triangulation.n_active_cells(), invalid);
+  std::vector<unsigned int> local_component(triangulation.n_active_cells(), invalid);
+  unsigned int n_local_components = 0;
+  for (cell = dof_handler.begin_active(); cell != endc; ++cell)
+    if (cell->is_locally_owned() && parent[cell->active_cell_index()] != invalid)
+      {
+        const unsigned int root = find_root(parent, cell->active_cell_index());
+        if (local_component[root] == invalid)
+          local_component[root] = n_local_components++;
+      }
+  unsigned int first_label = 0;
+  MPI_Exscan(&n_local_components, &first_label, 1, MPI_UNSIGNED, MPI_SUM, mpi_com);
+  if (my_rank == 0)
+    first_label = 0;
+  const unsigned int n_labels = Utilities::MPI::sum(n_local_components, mpi_com);
+
+  for (cell = dof_handler.begin_active(); cell != endc; ++cell)
+    if (cell->is_locally_owned() && parent[cell->active_cell_index()] != invalid)
+      label[cell->active_cell_index()]
+        = first_label + local_component[find_root(parent, cell->active_cell_index())];
+
+  GridTools::exchange_cell_data_to_ghosts<unsigned int, DoFHandler<dim> > (
+    dof_handler,
+    [&](const typename DoFHandler<dim>::active_cell_iterator &c)
+  {
+    return label[c->active_cell_index()];
+  },
+  [&](const typename DoFHandler<dim>::active_cell_iterator &c, const unsigned int &l)
+  {
+    label[c->active_cell_index()] = l;
+  });
 
-        fe_values.get_function_values(rel_solution, solution_values);
-        fe_values.get_function_gradients(rel_solution, solution_grads);
+  // join the labels meeting at processor boundaries
+  std::vector<unsigned int> local_joins;
+  for (cell = dof_handler.begin_active(); cell != endc; ++cell)
+    if (cell->is_locally_owned() && label[cell->active_cell_index()] != invalid)
+      {
+        collect_neighbors(cell);
+        for (unsigned int n = 0; n < neighbors.size(); ++n)
+          if (neighbors[n]->is_ghost()
+              && label[neighbors[n]->active_cell_index()] != invalid)
+            {
+              local_joins.push_back(label[cell->active_cell_index()]);
+              local_joins.push_back(label[neighbors[n]->active_cell_index()]);
+            }
+      }
+  const std::vector<std::vector<unsigned int> > joins
+    = Utilities::MPI::all_gather(mpi_com, local_joins);
+
+  std::vector<unsigned int> label_parent(n_labels);
+  for (unsigned int l = 0; l < n_labels; ++l)
+    label_parent[l] = l;
+  for (unsigned int r = 0; r < joins.size(); ++r)
+    for (unsigned int k = 0; k + 1 < joins[r].size(); k += 2)
+      label_parent[find_root(label_parent, joins[r][k])] = find_root(label_parent, joins[r][k+1]);
+
+  std::vector<unsigned int> component_of_label(n_labels, invalid);
+  unsigned int n_components = 0;
+  for (unsigned int l = 0; l < n_labels; ++l)
+    {
+      const unsigned int root = find_root(label_parent, l);
+      if (component_of_label[root] == invalid)
+        component_of_label[root] = n_components++;
+      component_of_label[l] = component_of_label[root];
+    }
 
-        for (unsigned int q = 0; q < n_q_points; ++q)
-          {
-            const Tensor<2,dim> grad_u = Tensors
-                                         ::get_grad_u<dim> (q, solution_grads);
+  // area, crack energy and bounding box of the components, and the
+  // point in the cell with the lowest phase field of each
+  std::vector<double> local_sums(2 * n_components, 0.0);
+  std::vector<double> local_lower(dim * n_components, std::numeric_limits<double>::max());
+  std::vector<double> local_upper(dim * n_components, -std::numeric_limits<double>::max());
+  std::vector<double> local_min_value(n_components, std::numeric_limits<double>::max());
+  std::vector<Point<dim> > local_points(n_components);
 
-            const Tensor<2,dim> E = 0.5 * (grad_u + transpose(grad_u));
-            const double tr_E = grad_u[0][0] + grad_u[1][1];
+  const QGauss<dim> quadrature_formula(degree+1);
+  const unsigned int n_q_points = quadrature_formula.size();
+  FEValues<dim> fe_values(fe, quadrature_formula,
+                          update_values | update_gradients | update_JxW_values);
+  const FEValuesExtractors::Scalar phase_field (dim);
+  std::vector<double> pf_values(n_q_points);
+  std::vector<Tensor<1,dim> > pf_grads(n_q_points);
 
-            const double pf = solution_values[q](dim);
+  Point<dim> inner_unit_point;
+  for (unsigned int d = 0; d < dim; ++d)
+    inner_unit_point[d] = 0.4;
 
-            const double tr_e_2 = trace(E*E);
+  for (cell = dof_handler.begin_active(); cell != endc; ++cell)
+    if (cell->is_locally_owned() && label[cell->active_cell_index()] != invalid)
+      {
+        const unsigned int c = component_of_label[label[cell->active_cell_index()]];
 
-            const double psi_e = 0.5 * lame_coefficient_lambda * tr_E*tr_E + lame_coefficient_mu * tr_e_2;
+        fe_values.reinit(cell);
+        fe_values[phase_field].get_function_values(rel_solution, pf_values);
+        fe_values[phase_field].get_function_gradients(rel_solution, pf_grads);
+        double min_value = pf_values[0];
+        for (unsigned int q = 0; q < n_q_points; ++q)
+          {
+            local_sums[2*c] += fe_values.JxW(q);
+            local_sums[2*c+1] += G_c/2.0 * ((pf_values[q]-1) * (pf_values[q]-1)/alpha_eps
+                                            + alpha_eps * pf_grads[q] * pf_grads[q])
+                                 * fe_values.JxW(q);
+            min_value = std::min(min_value, pf_values[q]);
+          }
 
-            local_bulk_energy += ((1+constant_k)*pf*pf+constant_k) * psi_e * fe_values.JxW(q);
+        for (unsigned int v = 0; v < GeometryInfo<dim>::vertices_per_cell; ++v)
+          for (unsigned int d = 0; d < dim; ++d)
+            {
+              local_lower[dim*c+d] = std::min(local_lower[dim*c+d], cell->vertex(v)[d]);
+              local_upper[dim*c+d] = std::max(local_upper[dim*c+d], cell->vertex(v)[d]);
+            }
 
-            local_crack_energy += G_c/2.0 * ((pf-1) * (pf-1)/alpha_eps + alpha_eps * scalar_product(grad_u, grad_u))
-                                  * fe_values.JxW(q);
+        // a point that is not on the faces of any refinement of the cell
+        if (min_value < local_min_value[c])
+          {
+            local_min_value[c] = min_value;
+            local_points[c] = StaticMappingQ1<dim>::mapping
+                              .transform_unit_to_real_cell(cell, inner_unit_point);
           }
-
       }
 
-  double bulk_energy = Utilities::MPI::sum(local_bulk_energy, mpi_com);
-  double crack_energy = Utilities::MPI::sum(local_crack_energy, mpi_com);
-
-  pcout << "No " << timestep_number << " time " << time
-        << " bulk energy: " << bulk_energy
-        << " crack energy: " << crack_energy;
+  std::vector<double> sums(local_sums.size());
+  Utilities::MPI::sum(local_sums, mpi_com, sums);
+  std::vector<double> lower(local_lower.size()), upper(local_upper.size());
+  Utilities::MPI::min(local_lower, mpi_com, lower);
+  Utilities::MPI::max(local_upper, mpi_com, upper);
+
+  std::vector<double> min_value(n_components);
+  Utilities::MPI::min(local_min_value, mpi_com, min_value);
+  std::vector<unsigned int> local_point_owner(n_components, invalid), point_owner(n_components);
+  for (unsigned int c = 0; c < n_components; ++c)
+    if (local_min_value[c] == min_value[c])
+      local_point_owner[c] = my_rank;
+  Utilities::MPI::min(local_point_owner, mpi_com, point_owner);
+  std::vector<double> local_coordinates(dim * n_components, 0.0), coordinates(dim * n_components);
+  for (unsigned int c = 0; c < n_components; ++c)
+    if (point_owner[c] == my_rank)
+      for (unsigned int d = 0; d < dim; ++d)
+        local_coordinates[dim*c+d] = local_points[c][d];
+  Utilities::MPI::sum(local_coordinates, mpi_com, coordinates);
+
+  // the components now containing the points of the last step
+  std::vector<unsigned int> local_successor(crack_component_points.size(), invalid);
+  std::vector<unsigned int> successor(crack_component_points.size());
+  for (unsigned int k = 0; k < crack_component_points.size(); ++k)
+    {
+      typename Triangulation<dim>::active_cell_iterator point_cell;
+      try
+        {
+          point_cell = GridTools::find_active_cell_around_point(grid_cache,
+                                                                crack_component_points[k]).first;
+        }
+      catch (const GridTools::ExcPointNotFound<dim> &)
+        {
+          continue;
+        }
+      if (point_cell->is_locally_owned() && label[point_cell->active_cell_index()] != invalid)
+        local_successor[k] = component_of_label[label[point_cell->active_cell_index()]];
+    }
+  Utilities::MPI::min(local_successor, mpi_com, successor);
 
+  pcout << "Crack components: " << n_components << std::endl;
+  for (unsigned int c = 0; c < n_components; ++c)
+    {
+      pcout << "Crack component " << c
+            << ": area " << sums[2*c]
+            << " bounding box [" << lower[dim*c] << "," << upper[dim*c] << "]x["
+            << lower[dim*c+1] << "," << upper[dim*c+1] << "]"
+            << " crack energy " << sums[2*c+1] << std::endl;
+
+      std::vector<unsigned int> merged;
+      for (unsigned int k = 0; k < successor.size(); ++k)
+        if (successor[k] == c)
+          merged.push_back(k);
+      if (merged.size() > 1)
+        {
+          pcout << "Crack merge: components";
+          for (unsigned int k = 0; k < merged.size(); ++k)
+            pcout << " " << merged[k];
+          pcout << " of the last step form component " << c << std::endl;
+        }
+    }
 
-  return 0;
+  if (my_rank == 0)
+    {
+      const std::string filename = output_directory + "/" + filename_basis + "crack_components.txt";
+      std::ofstream f(filename.c_str(), new_crack_component_file ? std::ios::out : std::ios::app);
+      if (new_crack_component_file)
+        {
+          f << "# time component area x_min y_min x_max y_max crack_energy" << std::endl;
+          new_crack_component_file = false;
+        }
+      for (unsigned int c = 0; c < n_components; ++c)
+        f << time << " " << c << " " << sums[2*c]
+          << " " << lower[dim*c] << " " << lower[dim*c+1]
+          << " " << upper[dim*c] << " " << upper[dim*c+1]
+          << " " << sums[2*c+1] << std::endl;
+    }
 
+  crack_component_points.resize(n_components);
+  for (unsigned int c = 0; c < n_components; ++c)
+    for (unsigned int d = 0; d < dim; ++d)
+      crack_component_points[c][d] = coordinates[dim*c+d];
 }
 
+
 // Here, we compute the four quantities of interest:
 // the x and y-displacements of the structure, the drag, and the lift.
 template <int dim>
@@ -3049,101 +5710,46 @@ FracturePhaseFieldProblem<dim>::compute_functional_values ()
   };
   const unsigned int n_lines = sizeof(lines) / sizeof(*lines);
 
-  static unsigned int no = 0;
-  ++no;
-  std::ostringstream filename;
-  filename <<  "cod-" << Utilities::int_to_string(no, 2) << "b.txt";
-  pcout << "writing " << filename.str() << std::endl;
-
-  std::ofstream f(filename.str().c_str());
-  for (unsigned int i = 0; i < n_lines; ++i)
-    {
-      double value = compute_cod(lines[i]);
-      f << lines[i] << " " << value << std::endl;
-    }
-
-//    double y_and_h = 2.0 + min_cell_diameter;
-//    double px[] = { 1.6, 1.8, 1.85, 1.9, 1.95, 2.0, 2.05, 2.1, 2.15, 2.2, 2.4 };
-//    const unsigned int n = sizeof(px) / sizeof(*px);
-//    std::vector<double> val(n);
-
-
-}
-
-
-template <int dim>
-void
-FracturePhaseFieldProblem<dim>::compute_load ()
-{
-  const QGauss<dim-1> face_quadrature_formula (3);
-  FEFaceValues<dim> fe_face_values (fe, face_quadrature_formula,
-                                    update_values | update_gradients | update_normal_vectors |
-                                    update_JxW_values);
-
-  const unsigned int dofs_per_cell = fe.dofs_per_cell;
-  const unsigned int n_face_q_points = face_quadrature_formula.size();
-
-  std::vector<unsigned int> local_dof_indices (dofs_per_cell);
-
-  std::vector<std::vector<Tensor<1,dim> > >
-  face_solution_grads (n_face_q_points, std::vector<Tensor<1,dim> > (dim+1));
-
-  Tensor<1,dim> load_value;
-
-  LA::MPI::BlockVector rel_solution(partition_relevant);
-  rel_solution = solution;
-
-  const Tensor<2, dim> Identity =
-    Tensors::get_Identity<dim>();
-
-  typename DoFHandler<dim>::active_cell_iterator
-  cell = dof_handler.begin_active(),
-  endc = dof_handler.end();
-
-  for (; cell!=endc; ++cell)
-    if (cell->is_locally_owned())
-      {
-        for (unsigned int face=0; face<GeometryInfo<dim>::faces_per_cell; ++face)
-          if (cell->face(face)->at_boundary() &&
-              cell->face(face)->boundary_id()==3)
-            {
-              fe_face_values.reinit (cell, face);
-              fe_face_values.get_function_gradients (rel_solution, face_solution_grads);
-
-              for (unsigned int q_point=0; q_point<n_face_q_points; ++q_point)
-                {
-                  const Tensor<2, dim> grad_u
-                    = Tensors::get_grad_u<dim>(q_point, face_solution_grads);
-
-                  const Tensor<2, dim> E = 0.5 * (grad_u + transpose(grad_u));
-                  const double tr_E = grad_u[0][0] + grad_u[1][1];
-
-                  Tensor<2, dim> stress_term;
-                  stress_term = lame_coefficient_lambda * tr_E * Identity
-                                + 2 * lame_coefficient_mu * E;
-
-                  load_value +=  stress_term *
-                                 fe_face_values.normal_vector(q_point)* fe_face_values.JxW(q_point);
-
-                }
-            } // end boundary 3 for structure
-
-
-      }
-
+  ++n_cod_files;
+  std::ostringstream filename;
+  filename << output_directory << "/" << filename_basis
+           << "cod-" << Utilities::int_to_string(n_cod_files, 2) << "b.txt";
+  pcout << "writing " << filename.str() << std::endl;
 
-  load_value[0] *= -1.0;
+  // vertical lines through the whole domain, all evaluated in one sweep
+  typename DoFHandler<dim>::cell_iterator cell = dof_handler.begin(0);
+  double y_min = cell->vertex(0)[1], y_max = cell->vertex(0)[1];
+  for (; cell != dof_handler.end(0); ++cell)
+    for (unsigned int v = 0; v < GeometryInfo<dim>::vertices_per_cell; ++v)
+      {
+        y_min = std::min(y_min, cell->vertex(v)[1]);
+        y_max = std::max(y_max, cell->vertex(v)[1]);
+      }
 
-  if (test_case == TestCase::miehe_tension)
+  std::vector<std::vector<Point<dim> > > polylines(n_lines, std::vector<Point<dim> >(2));
+  for (unsigned int i = 0; i < n_lines; ++i)
     {
-      pcout << "  Load y: " << Utilities::MPI::sum(load_value[1], mpi_com) << std::endl;
+      polylines[i][0] = Point<dim>(lines[i], y_min);
+      polylines[i][1] = Point<dim>(lines[i], y_max);
     }
-  else if (test_case == TestCase::miehe_shear)
+  const std::vector<double> values = compute_cod_lines(polylines);
+
+  std::ofstream f(filename.str().c_str());
+  for (unsigned int i = 0; i < n_lines; ++i)
     {
-      pcout << "  Load x: " << Utilities::MPI::sum(load_value[0], mpi_com) << std::endl;
+      pcout << lines[i] << "  " << values[i] << std::endl;
+      f << lines[i] << " " << values[i] << std::endl;
     }
+
+//    double y_and_h = 2.0 + min_cell_diameter;
+//    double px[] = { 1.6, 1.8, 1.85, 1.9, 1.95, 2.0, 2.05, 2.1, 2.15, 2.2, 2.4 };
+//    const unsigned int n = sizeof(px) / sizeof(*px);
+//    std::vector<double> val(n);
+
+
 }
 
+
 // Determine the phase-field regularization parameters
 // eps and kappa
 template <int dim>
@@ -3213,11 +5819,346 @@ FracturePhaseFieldProblem<dim>::determine_mesh_dependent_parameters()
 }
 
 
+// Set refine flags ahead of the crack tip. The driving force indicator
+// uses the homogeneous solution of the phase-field equation,
+// phi = (G_c/eps) / ((1-k) sigma^+ : E + G_c/eps), which is the value the
+// phase field tends to under the present strain. The rate indicator
+// extrapolates the phase field linearly by one more time step.
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::flag_predicted_crack_cells (
+  const LA::MPI::BlockVector &relevant_solution)
+{
+  if (predictive_refinement == PredictiveRefinement::none)
+    return;
+
+  // Only cells ahead of the crack are predicted: cells that already have
+  // a phase-field value below the refinement threshold are refined by
+  // the phase-field criterion and are not exchanged between processors
+  std::vector<unsigned int> local_dof_indices(fe.dofs_per_cell);
+  const auto cell_in_crack = [&](const typename DoFHandler<dim>::active_cell_iterator &cell)
+  {
+    cell->get_dof_indices(local_dof_indices);
+    for (unsigned int i=0; i<fe.dofs_per_cell; ++i)
+      if (fe.system_to_component_index(i).first == dim
+          && relevant_solution(local_dof_indices[i]) < value_phase_field_for_refinement)
+        return true;
+    return false;
+  };
+
+  std::vector<Point<dim> > local_predicted_points;
+
+  if (predictive_refinement == PredictiveRefinement::driving_force)
+    {
+      const QGauss<dim> quadrature_formula(degree+2);
+      const unsigned int n_q_points = quadrature_formula.size();
+
+      FEValues<dim> fe_values(fe, quadrature_formula, update_gradients);
+
+      std::vector<std::vector<Tensor<1, dim> > > solution_grads(
+        n_q_points, std::vector<Tensor<1, dim> >(dim+1));
+
+      const Tensor<2,dim> Identity = Tensors
+                                     ::get_Identity<dim> ();
+      Tensor<2,dim> zero_matrix;
+      zero_matrix.clear();
+
+      typename DoFHandler<dim>::active_cell_iterator cell =
+        dof_handler.begin_active(), endc = dof_handler.end();
+
+      for (; cell != endc; ++cell)
+        if (cell->is_locally_owned())
+          {
+            fe_values.reinit(cell);
+
+            if (test_case == TestCase::multiple_het)
+              {
+                E_modulus = func_emodulus->value(cell->center(), 0);
+                E_modulus += 1.0;
+
+                lame_coefficient_mu = E_modulus / (2.0 * (1 + poisson_ratio_nu));
+
+                lame_coefficient_lambda = (2 * poisson_ratio_nu * lame_coefficient_mu)
+                                          / (1.0 - 2 * poisson_ratio_nu);
+              }
+
+            fe_values.get_function_gradients(relevant_solution, solution_grads);
+
+            double driving_force = 0.0;
+            for (unsigned int q = 0; q < n_q_points; ++q)
+              {
+                const Tensor<2,dim> grad_u = Tensors
+                                             ::get_grad_u<dim> (q, solution_grads);
+
+                const Tensor<2,dim> E = 0.5 * (grad_u + transpose(grad_u));
+                const double tr_E = grad_u[0][0] + grad_u[1][1];
+
+                Tensor<2,dim> stress_term_plus;
+                Tensor<2,dim> stress_term_minus;
+                if (decompose_stress_matrix>0 && timestep_number>0)
+                  {
+                    decompose_stress(stress_term_plus, stress_term_minus,
+                                     E, tr_E, zero_matrix , 0.0,
+                                     lame_coefficient_lambda,
+                                     lame_coefficient_mu, false);
+                  }
+                else
+                  {
+                    stress_term_plus = lame_coefficient_lambda * tr_E * Identity
+                                       + 2 * lame_coefficient_mu * E;
+                  }
+
+                driving_force = std::max(driving_force,
+                                         scalar_product(stress_term_plus, E));
+              }
+
+            const double pf_predicted = (G_c/alpha_eps)
+                                        / ((1.0 - constant_k) * driving_force + G_c/alpha_eps);
+            if (pf_predicted < value_phase_field_for_refinement
+                && !cell_in_crack(cell))
+              local_predicted_points.push_back(cell->center());
+          }
+    }
+  else if (predictive_refinement == PredictiveRefinement::phase_field_rate)
+    {
+      LA::MPI::BlockVector old_solution_relevant(partition_relevant, mpi_com);
+      old_solution_relevant = old_solution;
+
+      typename DoFHandler<dim>::active_cell_iterator cell =
+        dof_handler.begin_active(), endc = dof_handler.end();
+
+      for (; cell != endc; ++cell)
+        if (cell->is_locally_owned() && !cell_in_crack(cell))
+          {
+            cell->get_dof_indices(local_dof_indices);
+            for (unsigned int i=0; i<fe.dofs_per_cell; ++i)
+              {
+                const unsigned int comp_i = fe.system_to_component_index(i).first;
+                if (comp_i != dim)
+                  continue; // only look at phase field
+
+                const double pf = relevant_solution(local_dof_indices[i]);
+                const double old_pf = old_solution_relevant(local_dof_indices[i]);
+                if (pf - (old_pf - pf) < value_phase_field_for_refinement)
+                  {
+                    local_predicted_points.push_back(cell->center());
+                    break;
+                  }
+              }
+          }
+    }
+
+  // Refine the band around the predicted cells of all processors
+  const std::vector<std::vector<Point<dim> > > predicted_points
+    = Utilities::MPI::all_gather(mpi_com, local_predicted_points);
+
+  // Sort the points into buckets of the size of the largest search
+  // radius, then only the neighboring buckets have to be searched
+  Assert(dim==2, ExcNotImplemented());
+  const double bucket_size = predictive_refinement_band_width
+                             + dof_handler.begin(0)->diameter();
+  std::map<std::pair<int,int>, std::vector<Point<dim> > > buckets;
+  for (unsigned int p = 0; p < predicted_points.size(); ++p)
+    for (unsigned int k = 0; k < predicted_points[p].size(); ++k)
+      buckets[std::make_pair(static_cast<int>(std::floor(predicted_points[p][k][0]/bucket_size)),
+                             static_cast<int>(std::floor(predicted_points[p][k][1]/bucket_size)))]
+      .push_back(predicted_points[p][k]);
+
+  unsigned int n_flagged = 0;
+  typename DoFHandler<dim>::active_cell_iterator cell =
+    dof_handler.begin_active(), endc = dof_handler.end();
+  for (; cell != endc; ++cell)
+    if (cell->is_locally_owned() && !cell->refine_flag_set())
+      {
+        const Point<dim> center = cell->center();
+        const double max_distance = predictive_refinement_band_width
+                                    + 0.5 * cell->diameter();
+        const int bx = static_cast<int>(std::floor(center[0]/bucket_size));
+        const int by = static_cast<int>(std::floor(center[1]/bucket_size));
+
+        bool in_band = false;
+        for (int i = bx-1; i <= bx+1 && !in_band; ++i)
+          for (int j = by-1; j <= by+1 && !in_band; ++j)
+            {
+              typename std::map<std::pair<int,int>, std::vector<Point<dim> > >::const_iterator
+              bucket = buckets.find(std::make_pair(i,j));
+              if (bucket == buckets.end())
+                continue;
+              for (unsigned int k = 0; k < bucket->second.size(); ++k)
+                if (center.distance(bucket->second[k]) <= max_distance)
+                  {
+                    in_band = true;
+                    break;
+                  }
+            }
+
+        if (in_band)
+          {
+            cell->set_refine_flag();
+            ++n_flagged;
+          }
+      }
+
+  pcout << "Predictive refinement: "
+        << Utilities::MPI::sum(n_flagged, mpi_com) << " additional cells flagged" << std::endl;
+}
+
+
+// Adapt the mesh. If to_target_level is set, the flagging and
+// refinement of refine_mesh_once() is repeated on the interpolated
+// solution until no more cells are flagged, i.e., regions are refined
+// to the finest level in one adaptation without solving in between.
+// Only the first pass refines globally, by the Kelly indicator and
+// coarsens; the later ones repeat the phase-field, predictive and
+// fixed region flags.
+template <int dim>
+bool
+FracturePhaseFieldProblem<dim>::refine_mesh (const bool to_target_level)
+{
+  if (!to_target_level)
+    return refine_mesh_once();
+
+  const unsigned int max_passes = n_global_pre_refine+n_refinement_cycles+n_local_pre_refine;
+  unsigned int n_passes = 0;
+  while (n_passes < max_passes && refine_mesh_once(n_passes == 0))
+    ++n_passes;
+
+  if (n_passes > 1)
+    pcout << "Refined " << n_passes << " levels in one adaptation" << std::endl;
+
+  return (n_passes > 0);
+}
+
+
+// Set coarsen flags away from the crack band. Cells in the crack band
+// (phase field below the coarsening value in the current or the old
+// solution) and within the coarsening distance of it are never coarsened,
+// such that the phase field, and with it the irreversibility constraint
+// given by old_solution, is not changed by the restriction. Cells with a
+// refine flag and cells on the globally refined level are kept as well.
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::flag_cells_for_coarsening (
+  const LA::MPI::BlockVector &relevant_solution)
+{
+  // Crack band: cell centers of all processors
+  LA::MPI::BlockVector old_solution_relevant(partition_relevant, mpi_com);
+  old_solution_relevant = old_solution;
+
+  std::vector<Point<dim> > local_crack_points;
+  std::vector<unsigned int> local_dof_indices(fe.dofs_per_cell);
+  {
+    typename DoFHandler<dim>::active_cell_iterator cell =
+      dof_handler.begin_active(), endc = dof_handler.end();
+    for (; cell != endc; ++cell)
+      if (cell->is_locally_owned())
+        {
+          cell->get_dof_indices(local_dof_indices);
+          for (unsigned int i=0; i<fe.dofs_per_cell; ++i)
+            {
+              const unsigned int comp_i = fe.system_to_component_index(i).first;
+              if (comp_i != dim)
+                continue; // only look at phase field
+
+              if (relevant_solution(local_dof_indices[i]) < value_phase_field_for_coarsening
+                  || old_solution_relevant(local_dof_indices[i]) < value_phase_field_for_coarsening)
+                {
+                  local_crack_points.push_back(cell->center());
+                  break;
+                }
+            }
+        }
+  }
+
+  const std::vector<std::vector<Point<dim> > > crack_points
+    = Utilities::MPI::all_gather(mpi_com, local_crack_points);
+
+  // Sort the points into buckets of the size of the largest search
+  // radius, then only the neighboring buckets have to be searched
+  Assert(dim==2, ExcNotImplemented());
+  const double bucket_size = coarsening_distance + dof_handler.begin(0)->diameter();
+  std::map<std::pair<int,int>, std::vector<Point<dim> > > buckets;
+  for (unsigned int p = 0; p < crack_points.size(); ++p)
+    for (unsigned int k = 0; k < crack_points[p].size(); ++k)
+      buckets[std::make_pair(static_cast<int>(std::floor(crack_points[p][k][0]/bucket_size)),
+                             static_cast<int>(std::floor(crack_points[p][k][1]/bucket_size)))]
+      .push_back(crack_points[p][k]);
+
+  // Low Kelly indicators
+  std::vector<bool> refine_flags;
+  if (coarsening_kelly_fraction > 0.0)
+    {
+      Vector<float> estimated_error_per_cell (triangulation.n_active_cells());
+      std::vector<bool> component_mask(dim+1, true);
+      component_mask[dim] = false;
+
+      KellyErrorEstimator<dim>::estimate (dof_handler,
+                                          QGauss<dim-1>(degree+2),
+                                          typename FunctionMap<dim>::type(),
+                                          relevant_solution,
+                                          estimated_error_per_cell,
+                                          component_mask,
+                                          0,
+                                          0,
+                                          triangulation.locally_owned_subdomain());
+
+      // only the coarsen flags are wanted, keep the refine flags as they are
+      triangulation.save_refine_flags(refine_flags);
+      parallel::distributed::GridRefinement::
+      refine_and_coarsen_fixed_number (triangulation,
+                                       estimated_error_per_cell,
+                                       0.0, coarsening_kelly_fraction);
+      triangulation.load_refine_flags(refine_flags);
+    }
+
+  typename DoFHandler<dim>::active_cell_iterator cell =
+    dof_handler.begin_active(), endc = dof_handler.end();
+  for (; cell != endc; ++cell)
+    if (cell->is_locally_owned())
+      {
+        if (cell->refine_flag_set()
+            || cell->level() <= static_cast<int>(n_global_pre_refine))
+          {
+            cell->clear_coarsen_flag();
+            continue;
+          }
+
+        const Point<dim> center = cell->center();
+        const double max_distance = coarsening_distance + 0.5 * cell->diameter();
+        const int bx = static_cast<int>(std::floor(center[0]/bucket_size));
+        const int by = static_cast<int>(std::floor(center[1]/bucket_size));
+
+        bool near_crack = false;
+        for (int i = bx-1; i <= bx+1 && !near_crack; ++i)
+          for (int j = by-1; j <= by+1 && !near_crack; ++j)
+            {
+              typename std::map<std::pair<int,int>, std::vector<Point<dim> > >::const_iterator
+              bucket = buckets.find(std::make_pair(i,j));
+              if (bucket == buckets.end())
+                continue;
+              for (unsigned int k = 0; k < bucket->second.size(); ++k)
+                if (center.distance(bucket->second[k]) <= max_distance)
+                  {
+                    near_crack = true;
+                    break;
+                  }
+            }
+
+        // with a Kelly fraction given, only the flagged cells with low
+        // indicator are coarsened, otherwise all cells far from the crack
+        if (near_crack)
+          cell->clear_coarsen_flag();
+        else if (coarsening_kelly_fraction == 0.0)
+          cell->set_coarsen_flag();
+      }
+}
+
+
 template <int dim>
 bool
-FracturePhaseFieldProblem<dim>::refine_mesh ()
+FracturePhaseFieldProblem<dim>::refine_mesh_once (const bool first_pass)
 {
-  LA::MPI::BlockVector relevant_solution(partition_relevant);
+  LA::MPI::BlockVector relevant_solution(partition_relevant, mpi_com);
   relevant_solution = solution;
 
   if (refinement_strategy == RefinementStrategy::fixed_preref_sneddon)
@@ -3313,8 +6254,10 @@ FracturePhaseFieldProblem<dim>::refine_mesh ()
                   }
               }
           }
+
+      flag_predicted_crack_cells(relevant_solution);
     }
-  else if (refinement_strategy == RefinementStrategy::global)
+  else if (refinement_strategy == RefinementStrategy::global && first_pass)
     {
       typename DoFHandler<dim>::active_cell_iterator cell =
         dof_handler.begin_active(), endc = dof_handler.end();
@@ -3349,6 +6292,13 @@ FracturePhaseFieldProblem<dim>::refine_mesh ()
             }
       }
 
+      flag_predicted_crack_cells(relevant_solution);
+    }
+
+  // Kelly refinement of the displacements, not repeated when refining
+  // to the target level
+  if (refinement_strategy == RefinementStrategy::mix && first_pass)
+    {
       Vector<float> estimated_error_per_cell (triangulation.n_active_cells());
       std::vector<bool> component_mask(dim+1, true);
       component_mask[dim] = false;
@@ -3382,80 +6332,305 @@ FracturePhaseFieldProblem<dim>::refine_mesh ()
                                        0.3, 0.0);
 
 
-    }
+    }
+
+
+
+  // limit level
+  if (test_case != TestCase::sneddon_2d)
+    {
+      typename DoFHandler<dim>::active_cell_iterator cell =
+        dof_handler.begin_active(), endc = dof_handler.end();
+      for (; cell != endc; ++cell)
+        if (cell->is_locally_owned()
+            && cell->level() == static_cast<int>(n_global_pre_refine+n_refinement_cycles+n_local_pre_refine))
+          cell->clear_refine_flag();
+    }
+
+  if (coarsen_mesh && first_pass
+      && (refinement_strategy == RefinementStrategy::phase_field_ref
+          || refinement_strategy == RefinementStrategy::mix))
+    flag_cells_for_coarsening(relevant_solution);
+
+  // check if we are doing anything
+  bool mesh_refined = false;
+  {
+    bool refine = false;
+    bool coarsen = false;
+    triangulation.prepare_coarsening_and_refinement();
+
+    typename DoFHandler<dim>::active_cell_iterator cell =
+      dof_handler.begin_active(), endc = dof_handler.end();
+    for (; cell != endc; ++cell)
+      if (cell->is_locally_owned())
+        {
+          refine = refine || cell->refine_flag_set();
+          coarsen = coarsen || cell->coarsen_flag_set();
+        }
+
+    mesh_refined = (Utilities::MPI::sum(refine?1:0, mpi_com) > 0);
+    const bool mesh_coarsened = (Utilities::MPI::sum(coarsen?1:0, mpi_com) > 0);
+    if (!mesh_refined && !mesh_coarsened)
+      return false;
+
+    if (!mesh_refined)
+      pcout << "Mesh coarsened" << std::endl;
+  }
+
+  LA::MPI::BlockVector relevant_old_solution(partition_relevant, mpi_com);
+  LA::MPI::BlockVector relevant_old_old_solution(partition_relevant, mpi_com);
+  relevant_old_solution = old_solution;
+  relevant_old_old_solution = old_old_solution;
+
+  std::vector<const LA::MPI::BlockVector *> x(3);
+  x[0] = &relevant_solution;
+  x[1] = &relevant_old_solution;
+  x[2] = &relevant_old_old_solution;
+
+  parallel::distributed::SolutionTransfer<dim, LA::MPI::BlockVector> solution_transfer(
+    dof_handler);
+
+  solution_transfer.prepare_for_coarsening_and_refinement(x);
+
+  if (load_balancing == LoadBalancing::crack_weighted)
+    mark_crack_cells(relevant_solution);
+  triangulation.execute_coarsening_and_refinement();
+  setup_system();
+
+  LA::MPI::BlockVector tmp_v(partition, mpi_com);
+  LA::MPI::BlockVector tmp_vv(partition, mpi_com);
+  std::vector<LA::MPI::BlockVector *> tmp(3);
+  tmp[0] = &solution;
+  tmp[1] = &tmp_v;
+  tmp[2] = &tmp_vv;
+
+  solution_transfer.interpolate(tmp);
+  old_solution = tmp_v;
+  old_old_solution = tmp_vv;
+  probes_valid = false;
+
+  determine_mesh_dependent_parameters();
+
+  // Coarsening alone happens away from the crack and does not
+  // require to recompute the time step
+  return mesh_refined;
+}
+
+// Remember which cells are in the crack band, i.e., have a phase-field
+// value below the load balancing value. The cell weights are computed
+// from this while the old mesh is still available.
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::mark_crack_cells (
+  const LA::MPI::BlockVector &relevant_solution)
+{
+  crack_cells.assign(triangulation.n_active_cells(), false);
+
+  std::vector<unsigned int> local_dof_indices(fe.dofs_per_cell);
+  typename DoFHandler<dim>::active_cell_iterator cell =
+    dof_handler.begin_active(), endc = dof_handler.end();
+  for (; cell != endc; ++cell)
+    if (cell->is_locally_owned())
+      {
+        cell->get_dof_indices(local_dof_indices);
+        for (unsigned int i=0; i<fe.dofs_per_cell; ++i)
+          if (fe.system_to_component_index(i).first == dim
+              && relevant_solution(local_dof_indices[i]) < value_phase_field_for_load_balancing)
+            {
+              crack_cells[cell->active_cell_index()] = true;
+              break;
+            }
+      }
+}
+
+
+// Additional weight of a cell for the partitioning (the base weight of
+// every cell is 1000). Cells in the crack band get the weight of their
+// relative assembly cost. Coarsened cells are counted as crack cells if
+// any of their children is one.
+template <int dim>
+unsigned int
+FracturePhaseFieldProblem<dim>::cell_weight (
+  const typename parallel::distributed::Triangulation<dim>::cell_iterator &cell,
+  const typename parallel::distributed::Triangulation<dim>::CellStatus status) const
+{
+  if (crack_cells.size() != triangulation.n_active_cells())
+    return 0;
+
+  bool in_crack = false;
+  if (status == parallel::distributed::Triangulation<dim>::CELL_COARSEN)
+    {
+      for (unsigned int c=0; c<cell->n_children(); ++c)
+        if (cell->child(c)->active()
+            && crack_cells[cell->child(c)->active_cell_index()])
+          in_crack = true;
+    }
+  else if (cell->active())
+    in_crack = crack_cells[cell->active_cell_index()];
+
+  if (!in_crack)
+    return 0;
+
+  return static_cast<unsigned int>(1000.0 * (crack_cell_weight - 1.0) + 0.5);
+}
 
 
+// Print the imbalance of the assembly time over all processors and
+// repartition the mesh with weighted crack cells if it exceeds the
+// threshold. The relative cost of crack cells is taken from the
+// measured assembly times unless it is given in the parameter file.
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::balance_load ()
+{
+  const Utilities::MPI::MinMaxAvg assembly_time
+    = Utilities::MPI::min_max_avg(assembly_time_crack + assembly_time_intact, mpi_com);
+  const double imbalance = (assembly_time.avg > 0.0
+                            ? assembly_time.max / assembly_time.avg
+                            : 1.0);
 
-  // limit level
-  if (test_case != TestCase::sneddon_2d)
-    {
-      typename DoFHandler<dim>::active_cell_iterator cell =
-        dof_handler.begin_active(), endc = dof_handler.end();
-      for (; cell != endc; ++cell)
-        if (cell->is_locally_owned()
-            && cell->level() == static_cast<int>(n_global_pre_refine+n_refinement_cycles+n_local_pre_refine))
-          cell->clear_refine_flag();
-    }
+  pcout << "Assembly time per core (min/avg/max): "
+        << assembly_time.min << " / " << assembly_time.avg << " / "
+        << assembly_time.max << " s   imbalance: " << imbalance << std::endl;
 
-  // check if we are doing anything
-  {
-    bool refine_or_coarsen = false;
-    triangulation.prepare_coarsening_and_refinement();
+  if (load_balancing == LoadBalancing::crack_weighted)
+    {
+      if (measure_crack_cell_weight)
+        {
+          std::vector<double> local_cost(4), global_cost(4);
+          local_cost[0] = assembly_time_crack;
+          local_cost[1] = n_assembled_crack;
+          local_cost[2] = assembly_time_intact;
+          local_cost[3] = n_assembled_intact;
+          Utilities::MPI::sum(local_cost, mpi_com, global_cost);
+
+          // keep the last weight if one of the cell types is missing
+          if (global_cost[1] > 0 && global_cost[3] > 0 && global_cost[2] > 0.0)
+            crack_cell_weight = std::min(100.0, std::max(1.0,
+                                                         (global_cost[0]/global_cost[1])
+                                                         / (global_cost[2]/global_cost[3])));
+          pcout << "Relative cost of crack cells: " << crack_cell_weight << std::endl;
+        }
 
-    typename DoFHandler<dim>::active_cell_iterator cell =
-      dof_handler.begin_active(), endc = dof_handler.end();
-    for (; cell != endc; ++cell)
-      if (cell->is_locally_owned() &&
-          (cell->refine_flag_set() || cell->coarsen_flag_set()))
+      if (imbalance > load_imbalance_threshold)
         {
-          refine_or_coarsen = true;
-          break;
+          LA::MPI::BlockVector relevant_solution(partition_relevant, mpi_com);
+          LA::MPI::BlockVector relevant_old_solution(partition_relevant, mpi_com);
+          LA::MPI::BlockVector relevant_old_old_solution(partition_relevant, mpi_com);
+          relevant_solution = solution;
+          relevant_old_solution = old_solution;
+          relevant_old_old_solution = old_old_solution;
+          mark_crack_cells(relevant_solution);
+
+          std::vector<const LA::MPI::BlockVector *> x(3);
+          x[0] = &relevant_solution;
+          x[1] = &relevant_old_solution;
+          x[2] = &relevant_old_old_solution;
+
+          parallel::distributed::SolutionTransfer<dim, LA::MPI::BlockVector> solution_transfer(
+            dof_handler);
+          solution_transfer.prepare_for_coarsening_and_refinement(x);
+
+          triangulation.repartition();
+          setup_system();
+
+          LA::MPI::BlockVector tmp_v(partition, mpi_com);
+          LA::MPI::BlockVector tmp_vv(partition, mpi_com);
+          std::vector<LA::MPI::BlockVector *> tmp(3);
+          tmp[0] = &solution;
+          tmp[1] = &tmp_v;
+          tmp[2] = &tmp_vv;
+
+          solution_transfer.interpolate(tmp);
+          old_solution = tmp_v;
+          old_old_solution = tmp_vv;
+
+          probes_valid = false;
+          ++n_repartitions;
+          pcout << "Mesh repartitioned (" << n_repartitions << " times so far)" << std::endl;
         }
+    }
 
-    if (Utilities::MPI::sum(refine_or_coarsen?1:0, mpi_com)==0)
-      return false;
-  }
+  assembly_time_crack = assembly_time_intact = 0.0;
+  n_assembled_crack = n_assembled_intact = 0;
+}
 
-  std::vector<const LA::MPI::BlockVector *> x(3);
-  x[0] = &relevant_solution;
-  x[1] = &old_solution;
-  x[2] = &old_old_solution;
 
-  parallel::distributed::SolutionTransfer<dim, LA::MPI::BlockVector> solution_transfer(
-    dof_handler);
+// Compare the DoF renumberings: time the assembly of the residual
+// and matrix-vector products with the system matrix on the current
+// mesh for each of them. The selected renumbering is restored at the
+// end, the solution vectors are reset.
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::benchmark_dof_renumbering ()
+{
+  const typename DoFRenumberingType::Enum selected = dof_renumbering;
+  const char *names[] = {"none", "Cuthill-McKee"};
+  const unsigned int n_assemblies = 5;
+  const unsigned int n_vmults = 50;
+
+  pcout << "DoF renumbering benchmark (" << n_assemblies << " residual assemblies, "
+        << n_vmults << " matrix-vector products):" << std::endl;
+  for (unsigned int r = 0; r < 2; ++r)
+    {
+      dof_renumbering = static_cast<typename DoFRenumberingType::Enum>(r);
+      setup_system();
+      assemble_system();
 
-  solution_transfer.prepare_for_coarsening_and_refinement(x);
+      Timer assembly_timer;
+      for (unsigned int i = 0; i < n_assemblies; ++i)
+        assemble_system(true);
+      assembly_timer.stop();
+
+      solution = 1.0;
+      Timer vmult_timer;
+      for (unsigned int i = 0; i < n_vmults; ++i)
+        system_pde_matrix.vmult(newton_update, solution);
+      vmult_timer.stop();
+
+      const double assembly_time = Utilities::MPI::max(assembly_timer.wall_time(), mpi_com);
+      const double vmult_time = Utilities::MPI::max(vmult_timer.wall_time(), mpi_com);
+      pcout << "  " << std::setw(14) << std::left << names[r] << std::right
+            << "assembly: " << n_assemblies * triangulation.n_global_active_cells() / assembly_time
+            << " cells/s   SpMV: " << 1.0e-6 * n_vmults * system_pde_matrix.n_nonzero_elements() / vmult_time
+            << " Mnnz/s" << std::endl;
+    }
 
-  triangulation.execute_coarsening_and_refinement();
+  dof_renumbering = selected;
   setup_system();
 
-  LA::MPI::BlockVector tmp_v(partition);
-  LA::MPI::BlockVector tmp_vv(partition);
-  std::vector<LA::MPI::BlockVector *> tmp(3);
-  tmp[0] = &solution;
-  tmp[1] = &tmp_v;
-  tmp[2] = &tmp_vv;
-
-  solution_transfer.interpolate(tmp);
-  old_solution = tmp_v;
-  old_old_solution = tmp_vv;
-
-  determine_mesh_dependent_parameters();
-  return true;
+  // do not count the benchmark for the load balancing
+  assembly_time_crack = assembly_time_intact = 0.0;
+  n_assembled_crack = n_assembled_intact = 0;
 }
 
-// As usual, we have to call the run method.
+
+// Reads the mesh and sets up the initial state (or the state of the
+// checkpoint to restart from). Called once, before the first advance().
 template <int dim>
 void
-FracturePhaseFieldProblem<dim>::run ()
+FracturePhaseFieldProblem<dim>::initialize ()
 {
+  AssertThrow(!initialized, ExcMessage("The problem is already initialized"));
+
   pcout << "Running on " << Utilities::MPI::n_mpi_processes(mpi_com)
         << " cores" << std::endl;
 
   set_runtime_parameters();
-  setup_system();
+  if (load_balancing == LoadBalancing::crack_weighted)
+    triangulation.signals.cell_weight.connect(
+      std::bind(&FracturePhaseFieldProblem<dim>::cell_weight, this,
+                std::placeholders::_1, std::placeholders::_2));
+
+  const bool restart = !restart_checkpoint.empty();
+  if (restart)
+    load_checkpoint(restart_checkpoint);
+  else if (mesh_cache_hit)
+    load_mesh_cache();
+  else
+    setup_system();
 
-  for (unsigned int i = 0; i < n_local_pre_refine; ++i)
+  for (unsigned int i = 0; i < n_local_pre_refine && !restart && !mesh_cache_hit; ++i)
     {
       ConstraintMatrix constraints;
       constraints.close();
@@ -3487,7 +6662,7 @@ FracturePhaseFieldProblem<dim>::run ()
 
     }
 
-  if (n_local_pre_refine==0)
+  if (n_local_pre_refine==0 && !restart && !mesh_cache_hit)
     determine_mesh_dependent_parameters();
 
   AssertThrow(alpha_eps >= min_cell_diameter, ExcMessage("You need to pick eps >= h"));
@@ -3506,76 +6681,137 @@ FracturePhaseFieldProblem<dim>::run ()
         << "Lame lambda:       " << lame_coefficient_lambda << "\n"
         << std::endl;
 
+  if (dof_renumbering_benchmark)
+    {
+      // The benchmark resets the solution vectors, which already hold
+      // the loaded state after a restart or with a cached mesh
+      const LA::MPI::BlockVector loaded_solution(solution);
+      const LA::MPI::BlockVector loaded_old_solution(old_solution);
+      const LA::MPI::BlockVector loaded_old_old_solution(old_old_solution);
+      benchmark_dof_renumbering();
+      solution = loaded_solution;
+      old_solution = loaded_old_solution;
+      old_old_solution = loaded_old_old_solution;
+    }
 
-  {
-    ConstraintMatrix constraints;
-    constraints.close();
 
-    if (test_case == TestCase::sneddon_2d)
-      {
-        VectorTools::interpolate(dof_handler,
-                                 InitialValuesSneddon<dim>(min_cell_diameter), solution);
-      }
-    else if (test_case == TestCase::multiple_homo)
-      {
-        VectorTools::interpolate(dof_handler,
-                                 InitialValuesMultipleHomo<dim>(min_cell_diameter), solution);
+  if (!restart)
+    {
+      ConstraintMatrix constraints;
+      constraints.close();
 
-      }
-    else if (test_case == TestCase::multiple_het)
-      {
-        VectorTools::interpolate(dof_handler,
-                                 InitialValuesMultipleHet<dim>(min_cell_diameter), solution);
+      if (!mesh_cache_hit)
+        {
+          if (test_case == TestCase::sneddon_2d)
+            {
+              VectorTools::interpolate(dof_handler,
+                                       InitialValuesSneddon<dim>(min_cell_diameter), solution);
+            }
+          else if (test_case == TestCase::multiple_homo)
+            {
+              VectorTools::interpolate(dof_handler,
+                                       InitialValuesMultipleHomo<dim>(min_cell_diameter), solution);
 
-      }
-    else
-      {
-        VectorTools::interpolate(dof_handler,
-                                 InitialValuesMiehe<dim>(min_cell_diameter), solution);
-      }
-    output_results();
-  }
+            }
+          else if (test_case == TestCase::multiple_het)
+            {
+              VectorTools::interpolate(dof_handler,
+                                       InitialValuesMultipleHet<dim>(min_cell_diameter), solution);
 
-  // Normalize phase-field function between 0 and 1
-  project_back_phase_field();
+            }
+          else
+            {
+              VectorTools::interpolate(dof_handler,
+                                       InitialValuesMiehe<dim>(min_cell_diameter), solution);
+            }
 
-  const unsigned int output_skip = 1;
-  unsigned int refinement_cycle = 0;
-  double finishing_timestep_loop = 0;
-  double tmp_timestep = 0.0;
+          if (!mesh_cache_name.empty())
+            save_mesh_cache();
+        }
+      output_results();
 
-  // Initialize old and old_old_solutions
-  // old_old is needed for extrapolation for pf_extra to avoid pf^2 in block(0,0)
-  old_old_solution = solution;
-  old_solution = solution;
+      // Normalize phase-field function between 0 and 1
+      project_back_phase_field();
 
-  // Initialize old and old_old timestep sizes
-  old_timestep = timestep;
-  old_old_timestep = timestep;
+      // Initialize old and old_old_solutions
+      // old_old is needed for extrapolation for pf_extra to avoid pf^2 in block(0,0)
+      old_old_solution = solution;
+      old_solution = solution;
 
-  // Timestep loop
-  do
-    {
+      // Initialize old and old_old timestep sizes
+      old_timestep = timestep;
+      old_old_timestep = timestep;
+    }
+  set_output_reference();
+
+  current_refinement_cycle = 0;
+  finishing_timestep_loop = 0;
+  time_loop_finished = false;
+  initialized = true;
+}
+
+
+// Computes up to n_steps time steps and returns the number of steps
+// computed, which is smaller if the end of the time loop is reached.
+template <int dim>
+unsigned int
+FracturePhaseFieldProblem<dim>::advance (const unsigned int n_steps)
+{
+  AssertThrow(initialized, ExcMessage("Call initialize() before advance()"));
+
+  unsigned int n_computed = 0;
+  for (; n_computed < n_steps && !finished(); ++n_computed)
+    do_timestep();
+
+  return n_computed;
+}
+
+
+template <int dim>
+bool
+FracturePhaseFieldProblem<dim>::finished () const
+{
+  return time_loop_finished || timestep_number > max_no_timesteps;
+}
 
-      {
-        //begin timer
-        TimerOutput::Scope t(timer, "Time step loop");
 
-        double newton_reduction = 1.0;
+// One step of the time loop, including the refinement cycles of the
+// Sneddon test once the solution is stationary
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::do_timestep ()
+{
+  double tmp_timestep = 0.0;
+
+  {
+    //begin timer
+    TimerOutput::Scope t(timer, "Time step loop");
+
+    double newton_reduction = 1.0;
+
 
+    if (timestep_control == TimestepControl::fixed
+        && timestep_number > switch_timestep && switch_timestep>0)
+      timestep = timestep_size_2;
 
-        if (timestep_number > switch_timestep && switch_timestep>0)
-          timestep = timestep_size_2;
+    tmp_timestep = timestep;
+    old_old_timestep = old_timestep;
+    old_timestep = timestep;
 
-        tmp_timestep = timestep;
-        old_old_timestep = old_timestep;
-        old_timestep = timestep;
+    // Compute next time step
+    old_old_solution = old_solution;
+    old_solution = solution;
 
-        // Compute next time step
-        old_old_solution = old_solution;
-        old_solution = solution;
+    // Newton iterations spent on this time step including
+    // all attempts that were rejected
+    step_newton_iterations = 0;
+    bool step_was_cut = false;
 
-redo_step:
+    // If the mesh is changed after the solve, the current time step
+    // is computed again on the new mesh.
+    bool mesh_changed = false;
+    do
+      {
         pcout << std::endl;
         pcout << "\n=============================="
               << "=========================================" << std::endl;
@@ -3598,24 +6834,36 @@ redo_step:
                 use_old_timestep_pf = false;
                 try
                   {
-                    newton_reduction = newton_active_set();
+                    set_initial_guess();
+                    if (use_elastic_predictor && elastic_predictor())
+                      {
+                        ++n_elastic_predictor_steps;
+                        pcout << "Elastic predictor accepted ("
+                              << n_elastic_predictor_steps << " steps so far)" << std::endl;
+                      }
+                    else
+                      newton_reduction = newton_active_set();
 
                     break;
 
                   }
                 catch (SolverControl::NoConvergence e)
                   {
-                    pcout << "Solver did not converge! Adjusting time step to " << timestep/10 << std::endl;
+                    pcout << "Solver did not converge! Adjusting time step." << std::endl;
+                  }
+
+                // Time step cut
+                if (!cut_timestep())
+                  {
+                    pcout << "Timestep at its minimum - taking step" << std::endl;
+                    break;
                   }
 
                 pcout << "Nehme nun old_timestep_pf" << std::endl;
                 use_old_timestep_pf = true;
                 solution = old_solution;
-
-                // Time step cut
-                time -= timestep;
-                timestep = timestep/10.0;
-                time += timestep;
+                rejected_newton_iterations += newton_iterations;
+                step_was_cut = true;
 
               }
             while (true);
@@ -3633,17 +6881,23 @@ redo_step:
                 use_old_timestep_pf = false;
                 try
                   {
+                    set_initial_guess();
                     // Normalize phase-field function between 0 and 1
                     project_back_phase_field();
                     newton_reduction = newton_iteration(time);
 
                     while (newton_reduction > upper_newton_rho)
                       {
+                        if (!cut_timestep())
+                          {
+                            pcout << "Timestep at its minimum - taking step" << std::endl;
+                            break;
+                          }
                         use_old_timestep_pf = true;
-                        time -= timestep;
-                        timestep = timestep/10.0;
-                        time += timestep;
-                        solution = old_solution;
+                        rejected_newton_iterations += newton_iterations;
+                        step_was_cut = true;
+                        set_initial_guess();
+                        project_back_phase_field();
                         newton_reduction = newton_iteration (time);
 
                         if (timestep < 1.0e-9)
@@ -3662,10 +6916,14 @@ redo_step:
                     pcout << "Solver did not converge! Adjusting time step." << std::endl;
                   }
 
-                time -= timestep;
+                if (!cut_timestep())
+                  {
+                    pcout << "Timestep at its minimum - taking step" << std::endl;
+                    break;
+                  }
+                rejected_newton_iterations += newton_iterations;
+                step_was_cut = true;
                 solution = old_solution;
-                timestep = timestep/10.0;
-                time += timestep;
 
               }
             while (true);
@@ -3678,131 +6936,184 @@ redo_step:
         project_back_phase_field();
         constraints_hanging_nodes.distribute(solution);
 
+        mesh_changed = false;
         if (test_case != TestCase::sneddon_2d)
           {
-            bool changed = refine_mesh();
-            if (changed)
+            mesh_changed = refine_mesh(refine_to_target_level);
+            if (mesh_changed)
               {
                 // redo the current time step
-                pcout << "MESH CHANGED!" << std::endl;
+                ++n_redone_steps;
+                pcout << "MESH CHANGED! (redone steps: " << n_redone_steps << ")" << std::endl;
+                rejected_newton_iterations += newton_iterations;
                 time -= timestep;
                 solution = old_solution;
-                goto redo_step;
-                continue;
               }
           }
+      }
+    while (mesh_changed);
+
+    pcout << "Newton iterations: " << step_newton_iterations
+          << " (total " << total_newton_iterations
+          << ", rejected " << rejected_newton_iterations << ")" << std::endl;
+
+    balance_load();
 
+    if (timestep_control == TimestepControl::adaptive)
+      {
+        // Take the size of the accepted step as basis for the next one
+        const double pf_change = phase_field_change(solution, old_solution);
+        timestep = compute_next_timestep(pf_change, step_was_cut);
+        pcout << "Phase-field change: " << pf_change
+              << "   next timestep: " << timestep << std::endl;
+      }
+    else
+      {
         // Set timestep to original timestep
         timestep = tmp_timestep;
+      }
 
-        // Compute functional values
+    // Compute functional values
+    pcout << std::endl;
+    compute_energy_and_load();
+    if (!probe_points.empty())
+      write_probe_values();
+    if (raster_resolution > 0)
+      write_phase_field_raster();
+    if (crack_path_output)
+      write_crack_path();
+    if (crack_components_output)
+      label_crack_components();
+    if (test_case == TestCase::sneddon_2d ||
+        test_case == TestCase::multiple_homo ||
+        test_case == TestCase::multiple_het)
+      {
         pcout << std::endl;
-        compute_energy();
-        if (test_case == TestCase::sneddon_2d ||
-            test_case == TestCase::multiple_homo ||
-            test_case == TestCase::multiple_het)
-          {
-            pcout << std::endl;
-            //They are computed below
-            //compute_functional_values();
-            //compute_cod_array();
-          }
-        else
-          compute_load();
+        //They are computed below
+        //compute_functional_values();
+        //compute_cod_array();
+      }
 
 
 
-        // Write solutions
-        if ((timestep_number % output_skip == 0))
-          output_results();
+    // Write solutions
+    if (output_due())
+      output_results();
 
-        // is this the residual? rename variable if not
-        LA::MPI::BlockVector residual(partition);
-        residual = old_solution;
-        residual.add(-1.0, solution);
+    // is this the residual? rename variable if not
+    LA::MPI::BlockVector residual(partition, mpi_com);
+    residual = old_solution;
+    residual.add(-1.0, solution);
 
-        // Abbruchkriterium time step algorithm
-        finishing_timestep_loop = residual.linfty_norm();
-        if (test_case == TestCase::sneddon_2d)
-          pcout << "Timestep difference linfty: " << finishing_timestep_loop << std::endl;
+    // Abbruchkriterium time step algorithm
+    finishing_timestep_loop = residual.linfty_norm();
+    if (test_case == TestCase::sneddon_2d)
+      pcout << "Timestep difference linfty: " << finishing_timestep_loop << std::endl;
 
-        ++timestep_number;
+    ++timestep_number;
 
-        if (test_case == TestCase::sneddon_2d && finishing_timestep_loop < 1.0e-5)
-          {
-            //compute_cod_array();
-            compute_functional_values();
+    if (checkpoint_interval > 0 && timestep_number % checkpoint_interval == 0)
+      save_checkpoint();
 
-            // Now we compare phi to our reference function
-            {
-              ExactPhiSneddon<dim> exact(alpha_eps);
-              Vector<float> error (triangulation.n_active_cells());
-
-              LA::MPI::BlockVector rel_solution(
-                partition_relevant);
-              rel_solution = solution;
-
-              ComponentSelectFunction<dim> value_select (dim, dim+1);
-              VectorTools::integrate_difference (dof_handler,
-                                                 rel_solution,
-                                                 exact,
-                                                 error,
-                                                 QGauss<dim>(fe.degree+2),
-                                                 VectorTools::L2_norm,
-                                                 &value_select);
-              const double local_error = error.l2_norm();
-              const double L2_error =  std::sqrt( Utilities::MPI::sum(local_error * local_error, mpi_com));
-              pcout << "phi_L2_error: " << L2_error << " h: " << min_cell_diameter << std::endl;
-            }
+    for (unsigned int i = 0; i < step_callbacks.size(); ++i)
+      step_callbacks[i](*this);
 
-            if (n_refinement_cycles==0)
-              break;
+    if (test_case == TestCase::sneddon_2d && finishing_timestep_loop < 1.0e-5)
+      {
+        //compute_cod_array();
+        compute_functional_values();
 
-            --n_refinement_cycles;
-            //timestep_number = 0;
-            pcout << std::endl;
-            pcout  << "\n================== " << std::endl;
-            pcout << "Refinement cycle " << refinement_cycle
-                  << "\n------------------ " << std::endl;
-
-            refine_mesh();
-            solution = 0;
-            ++refinement_cycle;
-            if (test_case == TestCase::sneddon_2d)
-              {
-                VectorTools::interpolate(dof_handler,
-                                         InitialValuesSneddon<dim>(min_cell_diameter), solution);
-              }
-            else if (test_case == TestCase::multiple_homo)
-              {
-                VectorTools::interpolate(dof_handler,
-                                         InitialValuesMultipleHomo<dim>(min_cell_diameter), solution);
+        // Now we compare phi to our reference function
+        {
+          ExactPhiSneddon<dim> exact(alpha_eps);
+          Vector<float> error (triangulation.n_active_cells());
+
+          LA::MPI::BlockVector rel_solution(
+            partition_relevant, mpi_com);
+          rel_solution = solution;
+
+          ComponentSelectFunction<dim> value_select (dim, dim+1);
+          VectorTools::integrate_difference (dof_handler,
+                                             rel_solution,
+                                             exact,
+                                             error,
+                                             QGauss<dim>(fe.degree+2),
+                                             VectorTools::L2_norm,
+                                             &value_select);
+          const double local_error = error.l2_norm();
+          const double L2_error =  std::sqrt( Utilities::MPI::sum(local_error * local_error, mpi_com));
+          pcout << "phi_L2_error: " << L2_error << " h: " << min_cell_diameter << std::endl;
+        }
 
-              }
-            else if (test_case == TestCase::multiple_het)
-              {
-                VectorTools::interpolate(dof_handler,
-                                         InitialValuesMultipleHet<dim>(min_cell_diameter), solution);
+        if (n_refinement_cycles==0)
+          {
+            time_loop_finished = true;
+            return;
+          }
 
-              }
-            else
-              VectorTools::interpolate(dof_handler,
-                                       InitialValuesMiehe<dim>(min_cell_diameter), solution);
+        --n_refinement_cycles;
+        //timestep_number = 0;
+        pcout << std::endl;
+        pcout  << "\n================== " << std::endl;
+        pcout << "Refinement cycle " << current_refinement_cycle
+              << "\n------------------ " << std::endl;
+
+        refine_mesh();
+        solution = 0;
+        ++current_refinement_cycle;
+        if (test_case == TestCase::sneddon_2d)
+          {
+            VectorTools::interpolate(dof_handler,
+                                     InitialValuesSneddon<dim>(min_cell_diameter), solution);
+          }
+        else if (test_case == TestCase::multiple_homo)
+          {
+            VectorTools::interpolate(dof_handler,
+                                     InitialValuesMultipleHomo<dim>(min_cell_diameter), solution);
 
           }
+        else if (test_case == TestCase::multiple_het)
+          {
+            VectorTools::interpolate(dof_handler,
+                                     InitialValuesMultipleHet<dim>(min_cell_diameter), solution);
+
+          }
+        else
+          VectorTools::interpolate(dof_handler,
+                                   InitialValuesMiehe<dim>(min_cell_diameter), solution);
 
+      }
 
-      } // end timer
 
-    }
-  while (timestep_number <= max_no_timesteps);
+  } // end timer
+}
+
+
+// Waits for the output still being written and prints the statistics
+// of the run
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::finalize ()
+{
+  flush_output();
+  if (output_group_com != MPI_COMM_NULL)
+    MPI_Comm_free(&output_group_com);
 
   pcout << std::endl;
   pcout << "Finishing time step loop: " << finishing_timestep_loop
         << std::endl;
+  pcout << "Total Newton iterations: " << total_newton_iterations
+        << " (thereof in rejected steps: " << rejected_newton_iterations << ")"
+        << std::endl;
+  pcout << "Time steps redone after mesh changes: " << n_redone_steps << std::endl;
+  if (load_balancing == LoadBalancing::crack_weighted)
+    pcout << "Repartitions: " << n_repartitions << std::endl;
+  if (use_elastic_predictor)
+    pcout << "Steps accepted by the elastic predictor: "
+          << n_elastic_predictor_steps << std::endl;
 
   pcout << std::resetiosflags(std::ios::floatfield) << std::fixed;
-  std::cout.precision(2);
+  pcout.get_stream().precision(2);
 
   Utilities::System::MemoryStats stats;
   Utilities::System::get_memory_stats(stats);
@@ -3810,61 +7121,83 @@ redo_step:
         << std::endl;
 }
 
-// The main function looks almost the same
-// as in all other deal.II tuturial steps.
-int
-main (
-  int argc, char *argv[])
+
+// As usual, we have to call the run method.
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::run ()
 {
-  Utilities::MPI::MPI_InitFinalize mpi_initialization(argc, argv, 1);
-  try
-    {
-      deallog.depth_console(0);
+  initialize();
+  while (!finished())
+    advance(1);
+  finalize();
+}
 
-      ParameterHandler prm;
-      FracturePhaseFieldProblem<2>::declare_parameters(prm);
-      if (argc>1)
-        {
-          if (!prm.read_input(argv[1], true))
-            AssertThrow(false, ExcMessage("could not read .prm!"));
-        }
-      else
-        {
-          std::ofstream out("default.prm");
-          prm.print_parameters (out,
-                                ParameterHandler::Text);
-          std::cout << "usage: ./cracks <parameter_file>" << std::endl
-                    << " (created default.prm)" << std::endl;
-          return 0;
-        }
 
+template <int dim>
+void
+FracturePhaseFieldProblem<dim>::add_step_callback (
+  const std::function<void (FracturePhaseFieldProblem<dim> &)> &callback)
+{
+  step_callbacks.push_back(callback);
+}
 
-      FracturePhaseFieldProblem<2> fracture_problem(1, prm);
-      fracture_problem.run();
-    }
-  catch (std::exception &exc)
-    {
-      std::cerr << std::endl << std::endl
-                << "----------------------------------------------------"
-                << std::endl;
-      std::cerr << "Exception on processing: " << std::endl << exc.what()
-                << std::endl << "Aborting!" << std::endl
-                << "----------------------------------------------------"
-                << std::endl;
 
-      return 1;
-    }
-  catch (...)
-    {
-      std::cerr << std::endl << std::endl
-                << "----------------------------------------------------"
-                << std::endl;
-      std::cerr << "Unknown exception!" << std::endl << "Aborting!" << std::endl
-                << "----------------------------------------------------"
-                << std::endl;
-      return 1;
-    }
+template <int dim>
+unsigned int
+FracturePhaseFieldProblem<dim>::get_timestep_number () const
+{
+  return timestep_number;
+}
 
-  return 0;
+
+template <int dim>
+double
+FracturePhaseFieldProblem<dim>::get_time () const
+{
+  return time;
+}
+
+
+template <int dim>
+double
+FracturePhaseFieldProblem<dim>::get_bulk_energy () const
+{
+  return bulk_energy;
+}
+
+
+template <int dim>
+double
+FracturePhaseFieldProblem<dim>::get_crack_energy () const
+{
+  return crack_energy;
 }
 
+
+template <int dim>
+const Tensor<1,dim> &
+FracturePhaseFieldProblem<dim>::get_load () const
+{
+  return load;
+}
+
+
+template <int dim>
+const LA::MPI::BlockVector &
+FracturePhaseFieldProblem<dim>::get_solution () const
+{
+  return solution;
+}
+
+
+template <int dim>
+const DoFHandler<dim> &
+FracturePhaseFieldProblem<dim>::get_dof_handler () const
+{
+  return dof_handler;
+}
+
+
+// The library is compiled for the 2d problem only
+template class FracturePhaseFieldProblem<2>;
@@ -0,0 +1,553 @@
+/**
+  This code is licensed under the "GNU GPL version 2 or later". See
+  LICENSE file or https://www.gnu.org/licenses/gpl-2.0.html
+
+  Copyright 2013-2015: Thomas Wick and Timo Heister
+*/
+
+// Geomechanics: Crack with phase-field
+// Interface of the solver, for the cracks program and for programs
+// that link to the cracks library
+
+#ifndef CRACKS_H
+#define CRACKS_H
+
+#include <deal.II/base/conditional_ostream.h>
+#include <deal.II/base/data_out_base.h>
+#include <deal.II/base/function.h>
+#include <deal.II/base/function_parser.h>
+#include <deal.II/base/index_set.h>
+#include <deal.II/base/parameter_handler.h>
+#include <deal.II/base/point.h>
+#include <deal.II/base/tensor.h>
+#include <deal.II/base/timer.h>
+
+#include <deal.II/lac/constraint_matrix.h>
+
+#include <deal.II/grid/grid_tools_cache.h>
+
+#include <deal.II/dofs/dof_handler.h>
+
+#include <deal.II/fe/fe_system.h>
+
+#include <deal.II/lac/generic_linear_algebra.h>
+namespace LA
+{
+  using namespace dealii::LinearAlgebraTrilinos;
+}
+#include <deal.II/distributed/tria.h>
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+// Main program
+//
+// The problem can be run as a whole with run(), or step by step:
+// initialize() once, then advance() by any number of time steps until
+// finished(), and finalize(). Between the steps and in the callbacks
+// registered with add_step_callback(), which are called after each
+// time step, the energies, the load, the solution and crack opening
+// displacements can be queried. All members taking a processor
+// communicator argument or working on the mesh are collective.
+template <int dim>
+class FracturePhaseFieldProblem
+{
+public:
+
+  FracturePhaseFieldProblem (
+    const unsigned int degree, dealii::ParameterHandler &,
+    const MPI_Comm &comm = MPI_COMM_WORLD, std::ostream &out = std::cout);
+  ~FracturePhaseFieldProblem ();
+  void
+  run ();
+  static void
+  declare_parameters (dealii::ParameterHandler &prm);
+
+  void
+  initialize ();
+  unsigned int
+  advance (const unsigned int n_steps);
+  bool
+  finished () const;
+  void
+  finalize ();
+
+  void
+  add_step_callback (
+    const std::function<void (FracturePhaseFieldProblem<dim> &)> &callback);
+
+  unsigned int
+  get_timestep_number () const;
+  double
+  get_time () const;
+  double
+  get_bulk_energy () const;
+  double
+  get_crack_energy () const;
+  const dealii::Tensor<1,dim> &
+  get_load () const;
+  const LA::MPI::BlockVector &
+  get_solution () const;
+  const dealii::DoFHandler<dim> &
+  get_dof_handler () const;
+
+  double
+  compute_point_value (
+    const dealii::DoFHandler<dim> &dofh, const LA::MPI::BlockVector &vector,
+    const dealii::Point<dim> &p, const unsigned int component) const;
+
+  double
+  compute_cod (
+    const double eval_line);
+
+  std::vector<double>
+  compute_cod_lines (
+    const std::vector<std::vector<dealii::Point<dim> > > &polylines);
+
+private:
+
+  void
+  do_timestep ();
+
+  void
+  set_runtime_parameters ();
+  void
+  determine_mesh_dependent_parameters();
+  void
+  setup_system ();
+  void
+  assemble_system (bool residual_only=false, bool elasticity_only=false);
+  void
+  assemble_nl_residual ();
+  void
+  assemble_nl_residual_batch (
+    const std::vector<double> &alphas,
+    std::vector<LA::MPI::BlockVector> &pde_residuals,
+    std::vector<LA::MPI::BlockVector> &total_residuals);
+  void
+  add_local_residual (
+    const dealii::FEValues<dim> &fe_values,
+    const unsigned int q,
+    const double cell_diameter,
+    const double current_pressure,
+    const double pf,
+    const double pf_extra,
+    const double pf_minus_old_timestep_pf_plus,
+    const dealii::Tensor<1,dim> &grad_pf,
+    const double divergence_u,
+    const dealii::Tensor<2,dim> &E,
+    const dealii::Tensor<2,dim> &stress_term_plus,
+    const dealii::Tensor<2,dim> &stress_term_minus,
+    dealii::Vector<double> &local_rhs) const;
+  double
+  extrapolated_pf (
+    const double old_timestep_pf,
+    const double old_old_timestep_pf) const;
+
+  void assemble_diag_mass_matrix();
+
+  void
+  set_initial_bc (
+    const double time);
+  void
+  set_newton_bc ();
+  void
+  set_initial_guess ();
+
+  unsigned int
+  solve ();
+  unsigned int
+  solve_elasticity ();
+
+  double newton_active_set();
+
+  bool elastic_predictor();
+
+  double
+  newton_iteration (
+    const double time);
+
+  unsigned int
+  line_search_batched (
+    const double reference_residual,
+    const bool use_linfty_norm,
+    double &new_residual);
+
+  void
+  output_results ();
+  void
+  flush_output ();
+  void
+  save_checkpoint ();
+  void
+  load_checkpoint (const std::string &name);
+  std::string
+  mesh_cache_key (const std::string &grid_name);
+  void
+  save_mesh_cache ();
+  void
+  load_mesh_cache ();
+  void
+  report_output_rate (
+    const unsigned int refinement_cycle, const std::pair<double, double> &size_and_time) const;
+
+  void
+  compute_functional_values ();
+
+
+  void compute_cod_array ();
+  unsigned int n_cod_files, n_cod_array_files;
+
+  void build_cell_buckets ();
+
+  void build_boundary_faces ();
+
+  void locate_probes ();
+  void write_probe_values ();
+  void write_phase_field_raster ();
+  void write_crack_path ();
+  void label_crack_components ();
+  void compute_energy_and_load ();
+
+  bool
+  refine_mesh (const bool to_target_level=false);
+  bool
+  refine_mesh_once (const bool first_pass=true);
+  void
+  flag_predicted_crack_cells (
+    const LA::MPI::BlockVector &relevant_solution);
+  void
+  flag_cells_for_coarsening (
+    const LA::MPI::BlockVector &relevant_solution);
+  void
+  project_back_phase_field ();
+
+  void
+  benchmark_dof_renumbering ();
+
+  void
+  mark_crack_cells (
+    const LA::MPI::BlockVector &relevant_solution);
+  unsigned int
+  cell_weight (
+    const typename dealii::parallel::distributed::Triangulation<dim>::cell_iterator &cell,
+    const typename dealii::parallel::distributed::Triangulation<dim>::CellStatus status) const;
+  void
+  balance_load ();
+
+  double
+  phase_field_change (
+    const LA::MPI::BlockVector &a, const LA::MPI::BlockVector &b) const;
+  unsigned int
+  active_set_size () const;
+  bool
+  output_due ();
+  void
+  set_output_reference ();
+  bool
+  cut_timestep ();
+  double
+  compute_next_timestep (
+    const double pf_change, const bool step_was_cut);
+
+  MPI_Comm mpi_com;
+
+  const unsigned int degree;
+  dealii::ParameterHandler &prm;
+
+  dealii::parallel::distributed::Triangulation<dim> triangulation;
+  dealii::GridTools::Cache<dim> grid_cache;
+
+  dealii::FESystem<dim> fe;
+  dealii::DoFHandler<dim> dof_handler;
+  dealii::ConstraintMatrix constraints_update;
+  dealii::ConstraintMatrix constraints_hanging_nodes;
+
+  LA::MPI::BlockSparseMatrix system_pde_matrix;
+  LA::MPI::BlockVector solution, newton_update,
+  old_solution, old_old_solution, system_pde_residual;
+  LA::MPI::BlockVector system_total_residual;
+
+  LA::MPI::BlockVector diag_mass, diag_mass_relevant;
+
+  dealii::ConditionalOStream pcout;
+  dealii::TimerOutput timer;
+
+  dealii::IndexSet active_set;
+
+  dealii::Function<dim> *func_emodulus;
+
+  std::vector<dealii::IndexSet> partition;
+  std::vector<dealii::IndexSet> partition_relevant;
+
+  std::vector<std::vector<bool> > constant_modes;
+
+  // Spatial index of the locally owned cells: cells sorted into the
+  // squares of a uniform grid by their bounding box. Rebuilt on demand
+  // after each change of the mesh.
+  std::map<std::pair<int,int>,
+      std::vector<typename dealii::DoFHandler<dim>::active_cell_iterator> > cell_buckets;
+  double cell_bucket_size;
+  bool cell_buckets_valid;
+
+  // Locally owned boundary faces (cell and face number) by boundary id
+  std::map<dealii::types::boundary_id,
+      std::vector<std::pair<typename dealii::DoFHandler<dim>::active_cell_iterator,
+      unsigned int> > > boundary_faces;
+  bool boundary_faces_valid;
+
+  // Sensor points: the locally owned ones are stored with their cell and
+  // the point in the reference cell, located again after mesh changes
+  std::vector<dealii::Point<dim> > probe_points;
+  std::vector<std::pair<unsigned int,
+      std::pair<typename dealii::DoFHandler<dim>::active_cell_iterator, dealii::Point<dim> > > > local_probes;
+  bool probes_valid;
+
+  // Number of pixels along the longer side of the phase-field images,
+  // 0 if none are written
+  unsigned int raster_resolution;
+
+  // Crack path: isoline of the phase field at the given value
+  bool crack_path_output;
+  double value_phase_field_for_crack_path;
+
+  // Connected components of the cells with phase field below the given
+  // value, with one point inside each component of the last step to
+  // detect merging cracks
+  bool crack_components_output;
+  double value_phase_field_for_crack_components;
+  std::vector<dealii::Point<dim> > crack_component_points;
+
+  LA::MPI::PreconditionAMG preconditioner_solid;
+  LA::MPI::PreconditionAMG preconditioner_phase_field;
+
+  // Global variables for timestepping scheme
+  unsigned int timestep_number;
+  unsigned int max_no_timesteps;
+  double timestep, timestep_size_2, time;
+  unsigned int switch_timestep;
+  struct OuterSolverType
+  {
+    enum Enum {active_set, simple_monolithic};
+  };
+  typename OuterSolverType::Enum outer_solver;
+
+  struct TestCase
+  {
+    enum Enum {sneddon_2d, miehe_tension, miehe_shear, multiple_homo, multiple_het};
+  };
+  typename TestCase::Enum test_case;
+
+  struct RefinementStrategy
+  {
+    enum Enum {phase_field_ref, fixed_preref_sneddon, fixed_preref_miehe_tension,
+               fixed_preref_miehe_shear, fixed_preref_multiple_homo, fixed_preref_multiple_het,
+               global, mix
+              };
+  };
+  typename RefinementStrategy::Enum refinement_strategy;
+
+  bool direct_solver;
+
+  double force_structure_x_biot, force_structure_y_biot;
+  double force_structure_x, force_structure_y;
+
+  // Biot parameters
+  double c_biot, alpha_biot, lame_coefficient_biot, K_biot, density_biot;
+
+  double gravity_x, gravity_y, volume_source, traction_x, traction_y,
+         traction_x_biot, traction_y_biot;
+
+  // Structure parameters
+  double density_structure;
+  double lame_coefficient_mu, lame_coefficient_lambda, poisson_ratio_nu;
+
+  // Other parameters to control the fluid mesh motion
+  double cell_diameter;
+
+  dealii::FunctionParser<1> func_pressure;
+  double constant_k, alpha_eps,
+         G_c, viscosity_biot, gamma_penal;
+
+  double E_modulus, E_prime;
+  double min_cell_diameter, norm_part_iterations, value_phase_field_for_refinement;
+
+  unsigned int n_global_pre_refine, n_local_pre_refine, n_refinement_cycles;
+  bool refine_to_target_level;
+  unsigned int n_redone_steps;
+
+  // Refinement ahead of the crack tip
+  struct PredictiveRefinement
+  {
+    enum Enum {none, driving_force, phase_field_rate};
+  };
+  typename PredictiveRefinement::Enum predictive_refinement;
+  double predictive_refinement_band_width;
+
+  // Coarsening away from the crack
+  bool coarsen_mesh;
+  double coarsening_distance, value_phase_field_for_coarsening,
+         coarsening_kelly_fraction;
+
+  // Load balancing with cell weights for the crack band
+  struct LoadBalancing
+  {
+    enum Enum {none, crack_weighted};
+  };
+  typename LoadBalancing::Enum load_balancing;
+  double load_imbalance_threshold, value_phase_field_for_load_balancing;
+  double crack_cell_weight;
+  bool measure_crack_cell_weight;
+  std::vector<bool> crack_cells;
+  // Measured assembly times (in seconds) of the locally owned cells
+  // since the last load balancing check
+  double assembly_time_crack, assembly_time_intact;
+  unsigned int n_assembled_crack, n_assembled_intact;
+  unsigned int n_repartitions;
+
+  double lower_bound_newton_residuum;
+  unsigned int max_no_newton_steps;
+  double upper_newton_rho;
+  unsigned int max_no_line_search_steps;
+  double line_search_damping;
+  struct LineSearchMode
+  {
+    enum Enum {backtracking, batched};
+  };
+  typename LineSearchMode::Enum line_search_mode;
+  unsigned int line_search_batch_size;
+  unsigned int n_residual_assemblies;
+  double decompose_stress_rhs, decompose_stress_matrix;
+  std::string filename_basis;
+  std::string output_directory, mesh_directory;
+  std::string emodulus_bitmap;
+
+  // Fields written and the cells they are written on
+  struct OutputProfile
+  {
+    enum Enum {full, standard, minimal};
+  };
+  typename OutputProfile::Enum output_profile;
+  bool output_crack_region_only;
+  double value_phase_field_for_output;
+  unsigned int output_background_level;
+
+  // Snapshots are written when the crack advances: the phase field,
+  // the active set or the crack energy changed by more than the given
+  // amounts since the last snapshot (zero disables a trigger), at
+  // least every output_interval steps and at most once per
+  // output_min_wall_time seconds
+  unsigned int output_interval;
+  double output_phase_field_change;
+  unsigned int output_active_set_growth;
+  double output_crack_energy_increase;
+  double output_min_wall_time;
+  LA::MPI::BlockVector output_reference_solution;
+  bool output_reference_valid;
+  double output_reference_crack_energy;
+  unsigned int output_reference_active_set_size;
+  unsigned int steps_since_output;
+  std::chrono::steady_clock::time_point output_reference_wall_time;
+
+  // Functional values of the last time step: bulk and crack energy and
+  // the traction on boundary 3 (Miehe tests only)
+  double bulk_energy, crack_energy;
+  dealii::Tensor<1,dim> load;
+
+  // Output files: one per processor (with .pvtu record), one per group
+  // of processors written with MPI-IO, or HDF5 with an XDMF time series
+  struct OutputMode
+  {
+    enum Enum {per_rank, vtu_in_parallel, hdf5};
+  };
+  typename OutputMode::Enum output_mode;
+  unsigned int output_n_groups;
+  MPI_Comm output_group_com;
+  std::vector<dealii::XDMFEntry> xdmf_entries;
+  dealii::DataOutBase::VtkFlags::ZlibCompressionLevel output_compression;
+
+  // Output written on background threads, at most output_queue_length
+  // steps are pending. Each returns the output number, size and time.
+  bool async_output;
+  unsigned int output_queue_length;
+  std::deque<std::future<std::pair<unsigned int, std::pair<double, double> > > > output_threads;
+  int output_cycle;
+  std::vector<std::vector<std::string> > output_file_names_by_timestep;
+
+  // Time series files are started new, or continued after a restart
+  bool new_probe_file;
+  bool new_crack_component_file;
+
+  // Checkpoints every checkpoint_interval steps, the last
+  // n_checkpoints_kept are kept
+  unsigned int checkpoint_interval;
+  unsigned int n_checkpoints_kept;
+  std::deque<std::string> checkpoint_names;
+  std::string restart_checkpoint;
+
+  // Cache of the pre-refined mesh with the initial solution, named by
+  // the hash of the parameters they depend on and the tag of the run
+  // that wrote them
+  std::string mesh_cache_directory;
+  std::string mesh_cache_name;
+  std::string mesh_cache_parameters;
+  unsigned long long mesh_cache_tag;
+  bool mesh_cache_hit;
+  double old_timestep, old_old_timestep;
+  bool use_old_timestep_pf;
+
+  // Adaptive time step control
+  struct TimestepControl
+  {
+    enum Enum {fixed, adaptive};
+  };
+  typename TimestepControl::Enum timestep_control;
+  double min_timestep, max_timestep, timestep_growth_limit;
+  unsigned int target_newton_iterations;
+  double target_pf_change;
+  double old_timestep_indicator;
+
+  // Newton statistics: iterations and number of active set changes of
+  // the last solve, and the sums over the current and all time steps
+  unsigned int newton_iterations, active_set_changes;
+  unsigned int step_newton_iterations, total_newton_iterations,
+           rejected_newton_iterations;
+
+  // Initial guess of Newton's method at a new time step
+  struct InitialGuess
+  {
+    enum Enum {previous, linear};
+  };
+  typename InitialGuess::Enum initial_guess;
+  bool extrapolate_phase_field;
+
+  // Renumbering of the DoFs within each block
+  struct DoFRenumberingType
+  {
+    enum Enum {none, cuthill_mckee};
+  };
+  typename DoFRenumberingType::Enum dof_renumbering;
+  bool dof_renumbering_benchmark;
+
+  // Elastic predictor: try to accept a step with frozen phase field
+  bool use_elastic_predictor;
+  unsigned int n_elastic_predictor_steps;
+
+  // State of the time loop between calls of advance()
+  bool initialized;
+  bool time_loop_finished;
+  unsigned int current_refinement_cycle;
+  double finishing_timestep_loop;
+  std::vector<std::function<void (FracturePhaseFieldProblem<dim> &)> > step_callbacks;
+};
+
+
+#endif
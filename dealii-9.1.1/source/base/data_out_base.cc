@@ -34,6 +34,7 @@
 #include <deal.II/base/data_out_base.h>
 #include <deal.II/base/memory_consumption.h>
 #include <deal.II/base/mpi.h>
+#include <deal.II/base/parallel.h>
 #include <deal.II/base/parameter_handler.h>
 #include <deal.II/base/thread_management.h>
 #include <deal.II/base/utilities.h>
@@ -250,9 +251,21 @@ namespace
       }
   }
 
+  /**
+   * Size in bytes of the blocks the data is split into before compression.
+   * Blocks are compressed independently of each other, and in parallel.
+   */
+  const std::size_t vtu_compression_block_size = 1 << 16;
+
   /**
    * Do a zlib compression followed by a base64 encoding of the given data. The
    * result is then written to the given stream.
+   *
+   * The data is split into blocks of vtu_compression_block_size bytes which
+   * are compressed in parallel. The header lists the number of blocks, the
+   * uncompressed size of a block and of the last block, and the compressed
+   * sizes of all blocks, as described in the VTK documentation of the
+   * vtkZLibDataCompressor.
    */
   template <typename T>
   void
@@ -262,37 +275,73 @@ namespace
   {
     if (data.size() != 0)
       {
-        // allocate a buffer for compressing data and do so
-        uLongf compressed_data_length = compressBound(data.size() * sizeof(T));
-        char * compressed_data        = new char[compressed_data_length];
-        int    err =
-          compress2(reinterpret_cast<Bytef *>(compressed_data),
-                    &compressed_data_length,
-                    reinterpret_cast<const Bytef *>(data.data()),
-                    data.size() * sizeof(T),
-                    get_zlib_compression_level(flags.compression_level));
-        (void)err;
-        Assert(err == Z_OK, ExcInternalError());
+        const std::size_t data_size = data.size() * sizeof(T);
+        const std::size_t n_blocks =
+          (data_size + vtu_compression_block_size - 1) /
+          vtu_compression_block_size;
+        const std::size_t last_block_size =
+          data_size - (n_blocks - 1) * vtu_compression_block_size;
+        const int compression_level =
+          get_zlib_compression_level(flags.compression_level);
+
+        // compress the blocks into separate buffers
+        std::vector<std::vector<char>> compressed_blocks(n_blocks);
+        parallel::apply_to_subranges(
+          std::size_t(0),
+          n_blocks,
+          [&](const std::size_t begin, const std::size_t end) {
+            for (std::size_t b = begin; b < end; ++b)
+              {
+                const std::size_t block_size =
+                  (b == n_blocks - 1 ? last_block_size :
+                                       vtu_compression_block_size);
+                uLongf compressed_data_length = compressBound(block_size);
+                compressed_blocks[b].resize(compressed_data_length);
+                int err = compress2(
+                  reinterpret_cast<Bytef *>(compressed_blocks[b].data()),
+                  &compressed_data_length,
+                  reinterpret_cast<const Bytef *>(data.data()) +
+                    b * vtu_compression_block_size,
+                  block_size,
+                  compression_level);
+                (void)err;
+                Assert(err == Z_OK, ExcInternalError());
+                compressed_blocks[b].resize(compressed_data_length);
+              }
+          },
+          1);
 
         // now encode the compression header
-        const uint32_t compression_header[4] = {
-          1,                                              /* number of blocks */
-          static_cast<uint32_t>(data.size() * sizeof(T)), /* size of block */
-          static_cast<uint32_t>(data.size() *
-                                sizeof(T)), /* size of last block */
-          static_cast<uint32_t>(
-            compressed_data_length)}; /* list of compressed sizes of blocks */
+        std::vector<uint32_t> compression_header(3 + n_blocks);
+        compression_header[0] = static_cast<uint32_t>(n_blocks);
+        compression_header[1] = static_cast<uint32_t>(
+          n_blocks > 1 ? vtu_compression_block_size : data_size);
+        compression_header[2] = static_cast<uint32_t>(last_block_size);
+        std::size_t compressed_data_length = 0;
+        for (std::size_t b = 0; b < n_blocks; ++b)
+          {
+            compression_header[3 + b] =
+              static_cast<uint32_t>(compressed_blocks[b].size());
+            compressed_data_length += compressed_blocks[b].size();
+          }
 
         char *encoded_header =
           encode_block(reinterpret_cast<const char *>(&compression_header[0]),
-                       4 * sizeof(compression_header[0]));
+                       compression_header.size() *
+                         sizeof(compression_header[0]));
         output_stream << encoded_header;
         delete[] encoded_header;
 
-        // next do the compressed data encoding in base64
+        // next do the compressed data encoding in base64. the blocks are
+        // encoded as one contiguous stream
+        std::vector<char> compressed_data;
+        compressed_data.reserve(compressed_data_length);
+        for (std::size_t b = 0; b < n_blocks; ++b)
+          compressed_data.insert(compressed_data.end(),
+                                 compressed_blocks[b].begin(),
+                                 compressed_blocks[b].end());
         char *encoded_data =
-          encode_block(compressed_data, compressed_data_length);
-        delete[] compressed_data;
+          encode_block(compressed_data.data(), compressed_data.size());
 
         output_stream << encoded_data;
         delete[] encoded_data;
@@ -0,0 +1,280 @@
+/**
+  This code is licensed under the "GNU GPL version 2 or later". See
+  LICENSE file or https://www.gnu.org/licenses/gpl-2.0.html
+
+  Copyright 2013-2015: Thomas Wick and Timo Heister
+*/
+
+// Geomechanics: Crack with phase-field
+// The cracks program: runs a parameter file or an ensemble of them
+// with the solver of the cracks library
+
+#include <deal.II/base/logstream.h>
+#include <deal.II/base/mpi.h>
+#include <deal.II/base/utilities.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cracks.h"
+
+using namespace dealii;
+
+
+// One run of an ensemble: a parameter file and the entries changed
+// for this run, given as "Subsection/Entry" and value
+struct EnsembleJob
+{
+  std::string parameter_file;
+  std::vector<std::pair<std::string, std::string> > changes;
+};
+
+// Read the parameter file of a job and apply its changes
+void read_job_parameters (ParameterHandler &prm, const EnsembleJob &job)
+{
+  if (!prm.read_input(job.parameter_file, true))
+    AssertThrow(false, ExcMessage("could not read .prm!"));
+
+  for (unsigned int i = 0; i < job.changes.size(); ++i)
+    {
+      const std::vector<std::string> path
+        = Utilities::split_string_list(job.changes[i].first, '/');
+      AssertThrow(path.size() > 0, ExcMessage("Invalid parameter <" + job.changes[i].first + ">"));
+      for (unsigned int k = 0; k + 1 < path.size(); ++k)
+        prm.enter_subsection(path[k]);
+      prm.set(path.back(), job.changes[i].second);
+      for (unsigned int k = 0; k + 1 < path.size(); ++k)
+        prm.leave_subsection();
+    }
+}
+
+// Agree within a group whether the last job failed on any processor.
+// This uses a communicator of its own, which the solver does not use.
+// A processor that failed alone may leave the others waiting in a
+// collective operation of the solver; after a grace period it aborts
+// the ensemble instead of letting it hang.
+bool job_failed_in_group (const bool failed, const MPI_Comm &status_com)
+{
+  const double grace_period = 300.0;
+
+  int local_failed = failed ? 1 : 0;
+  int n_failed = 0;
+  MPI_Request request;
+  MPI_Iallreduce(&local_failed, &n_failed, 1, MPI_INT, MPI_SUM, status_com, &request);
+
+  const double start = MPI_Wtime();
+  int done = 0;
+  while (!done)
+    {
+      MPI_Test(&request, &done, MPI_STATUS_IGNORE);
+      if (!done && failed && MPI_Wtime() - start > grace_period)
+        {
+          std::cerr << "A run failed on some processors of a group only, aborting"
+                    << std::endl;
+          MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+  return (n_failed > 0);
+}
+
+// Run the jobs on groups of group_size processors. A group takes the
+// next job from a counter on the first processor, accessed with MPI
+// one-sided communication, when it is done with the last one. Output
+// files and log of a job get the job number in their name.
+void run_ensemble (const std::vector<EnsembleJob> &jobs, const unsigned int group_size)
+{
+  const unsigned int world_rank = Utilities::MPI::this_mpi_process(MPI_COMM_WORLD);
+  const unsigned int n_groups
+    = std::max(1u, Utilities::MPI::n_mpi_processes(MPI_COMM_WORLD) / group_size);
+  const unsigned int group = std::min(world_rank / group_size, n_groups - 1);
+
+  MPI_Comm group_com;
+  MPI_Comm_split(MPI_COMM_WORLD, group, world_rank, &group_com);
+  MPI_Comm status_com;
+  MPI_Comm_dup(group_com, &status_com);
+  const bool group_leader = (Utilities::MPI::this_mpi_process(group_com) == 0);
+
+  unsigned int job_counter = 0;
+  MPI_Win job_counter_window;
+  MPI_Win_create(&job_counter, (world_rank == 0 ? sizeof(unsigned int) : 0),
+                 sizeof(unsigned int), MPI_INFO_NULL, MPI_COMM_WORLD,
+                 &job_counter_window);
+
+  if (world_rank == 0)
+    std::cout << "Ensemble of " << jobs.size() << " runs on " << n_groups
+              << " groups" << std::endl;
+
+  while (true)
+    {
+      unsigned int job = 0;
+      if (group_leader)
+        {
+          const unsigned int one = 1;
+          MPI_Win_lock(MPI_LOCK_SHARED, 0, 0, job_counter_window);
+          MPI_Fetch_and_op(&one, &job, MPI_UNSIGNED, 0, 0, MPI_SUM, job_counter_window);
+          MPI_Win_unlock(0, job_counter_window);
+        }
+      MPI_Bcast(&job, 1, MPI_UNSIGNED, 0, group_com);
+      if (job >= jobs.size())
+        break;
+
+      // A failed run is logged and does not stop the group: the other
+      // groups still need it to take part in freeing the job counter
+      std::ofstream log;
+      bool failed = false;
+      try
+        {
+          ParameterHandler prm;
+          FracturePhaseFieldProblem<2>::declare_parameters(prm);
+          read_job_parameters(prm, jobs[job]);
+
+          prm.enter_subsection("Global parameters");
+          const std::string filename_basis = prm.get("Output filename")
+                                             + "job" + Utilities::int_to_string(job, 4) + "_";
+          prm.set("Output filename", filename_basis);
+          const std::string output_directory = prm.get("Output directory");
+          prm.leave_subsection();
+
+          if (group_leader)
+            {
+              std::cout << "Group " << group << ": run " << job << " " << jobs[job].parameter_file;
+              for (unsigned int i = 0; i < jobs[job].changes.size(); ++i)
+                std::cout << " " << jobs[job].changes[i].first << "=" << jobs[job].changes[i].second;
+              std::cout << std::endl;
+            }
+
+          if (group_leader)
+            log.open((output_directory + "/" + filename_basis + "log.txt").c_str());
+
+          FracturePhaseFieldProblem<2> fracture_problem(1, prm, group_com, log);
+          fracture_problem.run();
+        }
+      catch (std::exception &exc)
+        {
+          failed = true;
+          std::cerr << "Group " << group << ": run " << job << " failed on processor "
+                    << world_rank << ": " << exc.what() << std::endl;
+          if (group_leader && log.is_open())
+            log << std::endl << "Run failed: " << exc.what() << std::endl;
+        }
+
+      if (job_failed_in_group(failed, status_com) && !failed && group_leader)
+        std::cerr << "Group " << group << ": run " << job
+                  << " failed on other processors of the group" << std::endl;
+    }
+
+  MPI_Win_free(&job_counter_window);
+  MPI_Comm_free(&status_com);
+  MPI_Comm_free(&group_com);
+}
+
+
+// The main function looks almost the same
+// as in all other deal.II tuturial steps.
+int
+main (
+  int argc, char *argv[])
+{
+  Utilities::MPI::MPI_InitFinalize mpi_initialization(argc, argv, 1);
+  try
+    {
+      deallog.depth_console(0);
+
+      // Ensemble: ./cracks --ensemble <group size> [--sweep <Subsection/Entry>
+      // <value1,value2,...>]... <parameter_file>...
+      // runs each parameter file with all combinations of the swept values
+      if (argc>2 && std::string(argv[1]) == "--ensemble")
+        {
+          const unsigned int group_size = Utilities::string_to_int(argv[2]);
+          AssertThrow(group_size > 0, ExcMessage("The group size must be positive"));
+
+          std::vector<std::string> parameter_files;
+          std::vector<std::pair<std::string, std::vector<std::string> > > sweeps;
+          for (int i = 3; i < argc; ++i)
+            if (std::string(argv[i]) == "--sweep")
+              {
+                AssertThrow(i+2 < argc, ExcMessage("--sweep needs a parameter and values"));
+                sweeps.push_back(std::make_pair(std::string(argv[i+1]),
+                                                Utilities::split_string_list(argv[i+2], ',')));
+                i += 2;
+              }
+            else
+              parameter_files.push_back(argv[i]);
+
+          std::vector<EnsembleJob> jobs;
+          for (unsigned int f = 0; f < parameter_files.size(); ++f)
+            {
+              std::vector<EnsembleJob> file_jobs(1);
+              file_jobs[0].parameter_file = parameter_files[f];
+              for (unsigned int w = 0; w < sweeps.size(); ++w)
+                {
+                  std::vector<EnsembleJob> swept_jobs;
+                  for (unsigned int j = 0; j < file_jobs.size(); ++j)
+                    for (unsigned int v = 0; v < sweeps[w].second.size(); ++v)
+                      {
+                        swept_jobs.push_back(file_jobs[j]);
+                        swept_jobs.back().changes.push_back(
+                          std::make_pair(sweeps[w].first, sweeps[w].second[v]));
+                      }
+                  file_jobs.swap(swept_jobs);
+                }
+              jobs.insert(jobs.end(), file_jobs.begin(), file_jobs.end());
+            }
+
+          run_ensemble(jobs, group_size);
+          return 0;
+        }
+
+      ParameterHandler prm;
+      FracturePhaseFieldProblem<2>::declare_parameters(prm);
+      if (argc>1)
+        {
+          if (!prm.read_input(argv[1], true))
+            AssertThrow(false, ExcMessage("could not read .prm!"));
+        }
+      else
+        {
+          std::ofstream out("default.prm");
+          prm.print_parameters (out,
+                                ParameterHandler::Text);
+          std::cout << "usage: ./cracks <parameter_file>" << std::endl
+                    << "   or: ./cracks --ensemble <group size> [--sweep <Subsection/Entry> <value1,value2,...>]... <parameter_file>..." << std::endl
+                    << " (created default.prm)" << std::endl;
+          return 0;
+        }
+
+
+      FracturePhaseFieldProblem<2> fracture_problem(1, prm);
+      fracture_problem.run();
+    }
+  catch (std::exception &exc)
+    {
+      std::cerr << std::endl << std::endl
+                << "----------------------------------------------------"
+                << std::endl;
+      std::cerr << "Exception on processing: " << std::endl << exc.what()
+                << std::endl << "Aborting!" << std::endl
+                << "----------------------------------------------------"
+                << std::endl;
+
+      return 1;
+    }
+  catch (...)
+    {
+      std::cerr << std::endl << std::endl
+                << "----------------------------------------------------"
+                << std::endl;
+      std::cerr << "Unknown exception!" << std::endl << "Aborting!" << std::endl
+                << "----------------------------------------------------"
+                << std::endl;
+      return 1;
+    }
+
+  return 0;
+}
+